@@ -0,0 +1,78 @@
+/* noisy.c
+
+   Noisy-neighbour benchmark for resident-set limits.  Starts a
+   child that keeps sweeping over a region bigger than physical
+   memory, then repeatedly touches a small working set of its own
+   and reports how many major faults that took, that is, how much
+   of its working set the child pushed out.
+
+   Usage: noisy [LIMIT]
+   LIMIT is the resident-set limit in pages given to the child
+   (default 0, no limit).  Compare "noisy" with e.g. "noisy 64". */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <syscall.h>
+
+#define PAGE_SIZE 4096
+#define THRASH_PAGES 1024       /* 4 MB: more than the user pool. */
+#define THRASH_PASSES 4
+#define WSET_PAGES 32
+#define WSET_ROUNDS 200
+
+static char thrash[THRASH_PAGES][PAGE_SIZE];
+static char wset[WSET_PAGES][PAGE_SIZE];
+
+static void
+sweep (char (*pages)[PAGE_SIZE], int cnt)
+{
+  int i;
+
+  for (i = 0; i < cnt; i++)
+    pages[i][0]++;
+}
+
+int
+main (int argc, char *argv[])
+{
+  struct vmstat st;
+  int limit, old_limit;
+  int before;
+  pid_t pid;
+  int i;
+
+  if (argc == 2 && !strcmp (argv[1], "thrash"))
+    {
+      for (i = 0; i < THRASH_PASSES; i++)
+        sweep (thrash, THRASH_PAGES);
+      return EXIT_SUCCESS;
+    }
+
+  limit = argc > 1 ? atoi (argv[1]) : 0;
+
+  /* Fault the working set in before the neighbour starts. */
+  sweep (wset, WSET_PAGES);
+
+  /* The limit is inherited by the child at exec time. */
+  old_limit = rss_limit (limit);
+  pid = exec ("noisy thrash");
+  rss_limit (old_limit);
+  if (pid == PID_ERROR)
+    {
+      printf ("noisy: exec failed\n");
+      return EXIT_FAILURE;
+    }
+
+  vmstat (VMSTAT_SELF, &st);
+  before = st.major_faults;
+  for (i = 0; i < WSET_ROUNDS; i++)
+    sweep (wset, WSET_PAGES);
+  vmstat (VMSTAT_SELF, &st);
+
+  wait (pid);
+  printf ("noisy: neighbour limited to %d pages: %d major faults "
+          "in %d sweeps of %d pages\n",
+          limit, (int) st.major_faults - before, WSET_ROUNDS, WSET_PAGES);
+  return EXIT_SUCCESS;
+}
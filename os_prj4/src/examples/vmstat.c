@@ -0,0 +1,80 @@
+/* vmstat.c
+
+   Prints paging statistics.  With no arguments, prints the
+   totals since boot.  Otherwise runs the command line given as
+   arguments and prints what changed while it ran. */
+
+#include <stdio.h>
+#include <string.h>
+#include <syscall.h>
+
+static void
+print_vmstat (const struct vmstat *st)
+{
+  int i;
+
+  printf ("faults: %u minor, %u major, %u stack growths\n",
+          st->minor_faults, st->major_faults, st->stack_growths);
+  printf ("evicted: %u file, %u mmap, %u stack\n",
+          st->evictions[VMSTAT_EVICT_FILE], st->evictions[VMSTAT_EVICT_MMAP],
+          st->evictions[VMSTAT_EVICT_STACK]);
+  printf ("swap: %u in, %u out\n", st->swap_ins, st->swap_outs);
+  printf ("fault cycles:\n");
+  for (i = 0; i < VMSTAT_HIST_BUCKETS; i++)
+    if (st->fault_hist[i] > 0)
+      printf ("  2^%-2d %u\n", i + VMSTAT_HIST_SHIFT, st->fault_hist[i]);
+}
+
+/* Subtracts every counter in B from the one in A. */
+static void
+vmstat_sub (struct vmstat *a, const struct vmstat *b)
+{
+  uint32_t *x = (uint32_t *) a;
+  const uint32_t *y = (const uint32_t *) b;
+  size_t i;
+
+  for (i = 0; i < sizeof *a / sizeof *x; i++)
+    x[i] -= y[i];
+}
+
+int
+main (int argc, char *argv[])
+{
+  struct vmstat before, after;
+  char cmd_line[128];
+  pid_t pid;
+  int i;
+
+  if (!vmstat (VMSTAT_GLOBAL, &before))
+    {
+      printf ("vmstat: not supported\n");
+      return EXIT_FAILURE;
+    }
+  if (argc < 2)
+    {
+      print_vmstat (&before);
+      return EXIT_SUCCESS;
+    }
+
+  /* Put the command line back together. */
+  cmd_line[0] = '\0';
+  for (i = 1; i < argc; i++)
+    {
+      if (i > 1)
+        strlcat (cmd_line, " ", sizeof cmd_line);
+      strlcat (cmd_line, argv[i], sizeof cmd_line);
+    }
+
+  pid = exec (cmd_line);
+  if (pid == PID_ERROR)
+    {
+      printf ("vmstat: exec of \"%s\" failed\n", cmd_line);
+      return EXIT_FAILURE;
+    }
+  printf ("vmstat: \"%s\" exited with code %d\n", cmd_line, wait (pid));
+
+  vmstat (VMSTAT_GLOBAL, &after);
+  vmstat_sub (&after, &before);
+  print_vmstat (&after);
+  return EXIT_SUCCESS;
+}
@@ -291,20 +291,46 @@ bitmap_all (const struct bitmap *b, size_t start, size_t cnt)
 /* Finds and returns the starting index of the first group of CNT
    consecutive bits in B at or after START that are all set to
    VALUE.
-   If there is no such group, returns BITMAP_ERROR. */
+   If there is no such group, returns BITMAP_ERROR.
+   Whole elements that contain no bit set to VALUE are skipped
+   with a single comparison, and after a failed candidate the
+   search resumes just past the bit that broke the run, so a
+   scan touches each bit at most a few times. */
 size_t
 bitmap_scan (const struct bitmap *b, size_t start, size_t cnt, bool value) 
 {
   ASSERT (b != NULL);
   ASSERT (start <= b->bit_cnt);
 
+  if (cnt == 0)
+    return start;
   if (cnt <= b->bit_cnt) 
     {
+      elem_type useless = value ? 0 : (elem_type) -1;
       size_t last = b->bit_cnt - cnt;
-      size_t i;
-      for (i = start; i <= last; i++)
-        if (!bitmap_contains (b, i, cnt, !value))
-          return i; 
+      size_t i = start;
+      while (i <= last)
+        {
+          size_t j;
+
+          if (i % ELEM_BITS == 0 && b->bits[elem_idx (i)] == useless)
+            {
+              i += ELEM_BITS;
+              continue;
+            }
+          if (bitmap_test (b, i) != value)
+            {
+              i++;
+              continue;
+            }
+
+          for (j = 1; j < cnt; j++)
+            if (bitmap_test (b, i + j) != value)
+              break;
+          if (j == cnt)
+            return i;
+          i += j + 1;
+        }
     }
   return BITMAP_ERROR;
 }
@@ -32,7 +32,23 @@ enum
 
     /* additional System calls */
     SYS_FIBONACCI,
-    SYS_MAX_OF_FOUR_INT
+    SYS_MAX_OF_FOUR_INT,
+    SYS_FORK,                   /* Duplicate this process. */
+    SYS_MMAP_FLAGS,             /* mmap() with MAP_* flags. */
+    SYS_MSYNC,                  /* Write a mapping back to its file. */
+    SYS_VMSTAT,                 /* Read paging statistics. */
+    SYS_RSS_LIMIT,              /* Limit a process's resident pages. */
+    SYS_MADVISE                 /* Describe how memory will be used. */
   };
 
+/* Flags for SYS_MMAP_FLAGS. */
+#define MAP_POPULATE 0x1        /* Read the whole file in at once. */
+
+/* Advice for SYS_MADVISE. */
+#define MADV_NORMAL 0           /* No special treatment. */
+#define MADV_RANDOM 1           /* Expect random access: no readahead. */
+#define MADV_SEQUENTIAL 2       /* Expect sequential access. */
+#define MADV_WILLNEED 3         /* Will be used soon: read it in. */
+#define MADV_DONTNEED 4         /* Not needed: free it now. */
+
 #endif /* lib/syscall-nr.h */
@@ -210,3 +210,39 @@ int max_of_four_int(int a, int b, int c, int d)
 {
   return syscall4(SYS_MAX_OF_FOUR_INT, a, b, c, d);
 }
+
+pid_t
+fork (void)
+{
+  return syscall0 (SYS_FORK);
+}
+
+mapid_t
+mmap_flags (int fd, void *addr, int flags)
+{
+  return syscall3 (SYS_MMAP_FLAGS, fd, addr, flags);
+}
+
+int
+msync (mapid_t mapid)
+{
+  return syscall1 (SYS_MSYNC, mapid);
+}
+
+bool
+vmstat (int which, struct vmstat *st)
+{
+  return syscall2 (SYS_VMSTAT, which, st);
+}
+
+int
+rss_limit (int pages)
+{
+  return syscall1 (SYS_RSS_LIMIT, pages);
+}
+
+int
+madvise (void *addr, unsigned length, int advice)
+{
+  return syscall3 (SYS_MADVISE, addr, length, advice);
+}
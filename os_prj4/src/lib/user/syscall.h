@@ -3,6 +3,8 @@
 
 #include <stdbool.h>
 #include <debug.h>
+#include <syscall-nr.h>
+#include <vmstat.h>
 
 /* Process identifier. */
 typedef int pid_t;
@@ -48,5 +50,11 @@ int inumber (int fd);
 /* additional System calls */
 int fibonacci(int n);
 int max_of_four_int(int a, int b, int c, int d);
+pid_t fork (void);
+mapid_t mmap_flags (int fd, void *addr, int flags);
+int msync (mapid_t);
+bool vmstat (int which, struct vmstat *);
+int rss_limit (int pages);
+int madvise (void *addr, unsigned length, int advice);
 
 #endif /* lib/user/syscall.h */
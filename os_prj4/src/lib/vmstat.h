@@ -0,0 +1,37 @@
+#ifndef __LIB_VMSTAT_H
+#define __LIB_VMSTAT_H
+
+/* Virtual memory statistics, kept per process and for the whole
+   system by the kernel and read with the vmstat() system call. */
+
+#include <stdint.h>
+
+/* Which statistics vmstat() returns. */
+#define VMSTAT_SELF 0           /* The calling process. */
+#define VMSTAT_GLOBAL 1         /* All processes since boot. */
+
+/* Page types counted separately on eviction. */
+#define VMSTAT_EVICT_FILE 0     /* Executable pages. */
+#define VMSTAT_EVICT_MMAP 1     /* Memory-mapped file pages. */
+#define VMSTAT_EVICT_STACK 2    /* Stack pages. */
+#define VMSTAT_EVICT_TYPES 3
+
+/* Fault service time histogram.  Bucket I counts faults that
+   took [2**(I + VMSTAT_HIST_SHIFT), 2**(I + VMSTAT_HIST_SHIFT + 1))
+   CPU cycles; the first and last buckets also take everything
+   below and above. */
+#define VMSTAT_HIST_SHIFT 8
+#define VMSTAT_HIST_BUCKETS 20
+
+struct vmstat
+  {
+    uint32_t minor_faults;      /* Resolved without I/O. */
+    uint32_t major_faults;      /* Read from a file or swap. */
+    uint32_t evictions[VMSTAT_EVICT_TYPES];
+    uint32_t swap_ins;          /* Pages read back from swap. */
+    uint32_t swap_outs;         /* Pages written to swap. */
+    uint32_t stack_growths;     /* Faults that extended the stack. */
+    uint32_t fault_hist[VMSTAT_HIST_BUCKETS];
+  };
+
+#endif /* lib/vmstat.h */
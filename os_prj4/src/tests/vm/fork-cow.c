@@ -0,0 +1,43 @@
+/* Forks while a buffer is resident, so that parent and child share
+   it copy-on-write.  The child overwrites the buffer, and the
+   parent checks that it still sees its own data.  The child prints
+   nothing unless it fails; its exit code tells the parent it got
+   through, so the output does not depend on scheduling. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define SIZE (16 * 4096)
+
+static char buf[SIZE];
+
+static void
+check_buf (char c)
+{
+  size_t i;
+
+  for (i = 0; i < SIZE; i++)
+    if (buf[i] != c)
+      fail ("byte %zu is '%c', not '%c'", i, buf[i], c);
+}
+
+void
+test_main (void)
+{
+  pid_t child;
+
+  memset (buf, 'p', sizeof buf);
+  CHECK ((child = fork ()) != -1, "fork");
+  if (child == 0)
+    {
+      check_buf ('p');
+      memset (buf, 'c', sizeof buf);
+      check_buf ('c');
+      exit (81);
+    }
+  CHECK (wait (child) == 81, "wait for child");
+  check_buf ('p');
+  msg ("parent buffer unchanged");
+}
@@ -0,0 +1,48 @@
+/* Fills 2 MB of memory, so that much of it is in swap, and forks.
+   The child checks the whole buffer and then rewrites part of it,
+   and the parent checks that its copy is intact afterward.  As in
+   fork-cow, only the parent prints. */
+
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define SIZE (2 * 1024 * 1024)
+#define CHILD_SIZE (512 * 1024)
+
+static char buf[SIZE];
+
+static void
+check_buf (size_t start, size_t end, int shift)
+{
+  size_t i;
+
+  for (i = start; i < end; i++)
+    if (buf[i] != (char) (i * 257 + shift))
+      fail ("byte %zu has wrong value", i);
+}
+
+void
+test_main (void)
+{
+  pid_t child;
+  size_t i;
+
+  msg ("initialize");
+  for (i = 0; i < SIZE; i++)
+    buf[i] = i * 257;
+
+  CHECK ((child = fork ()) != -1, "fork");
+  if (child == 0)
+    {
+      check_buf (0, SIZE, 0);
+      for (i = 0; i < CHILD_SIZE; i++)
+        buf[i] = i * 257 + 1;
+      check_buf (0, CHILD_SIZE, 1);
+      check_buf (CHILD_SIZE, SIZE, 0);
+      exit (81);
+    }
+  CHECK (wait (child) == 81, "wait for child");
+  check_buf (0, SIZE, 0);
+  msg ("parent buffer unchanged");
+}
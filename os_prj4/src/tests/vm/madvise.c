@@ -0,0 +1,54 @@
+/* Checks madvise: MADV_DONTNEED on bss makes the pages read as
+   zeros again, and on a file mapping writes changes back and
+   reloads the page from the file.  Bad ranges and advice make
+   madvise return -1 without killing the process. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/vm/sample.inc"
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define PAGE_SIZE 4096
+#define ACTUAL ((char *) 0x10000000)
+
+static char buf[4 * PAGE_SIZE] __attribute__ ((aligned (PAGE_SIZE)));
+
+void
+test_main (void)
+{
+  int handle;
+  mapid_t map;
+  size_t i;
+
+  /* Anonymous memory comes back zeroed. */
+  memset (buf, 'a', sizeof buf);
+  CHECK (madvise (buf, 2 * PAGE_SIZE, MADV_DONTNEED) == 0,
+         "madvise bss MADV_DONTNEED");
+  for (i = 0; i < sizeof buf; i++)
+    if (buf[i] != (i < 2 * PAGE_SIZE ? 0 : 'a'))
+      fail ("byte %zu of bss is %d after MADV_DONTNEED", i, buf[i]);
+  msg ("dropped bss pages read as zeros");
+
+  /* A mapped page is written back, then read in again. */
+  CHECK ((handle = open ("sample.txt")) > 1, "open \"sample.txt\"");
+  CHECK ((map = mmap (handle, ACTUAL)) != MAP_FAILED, "mmap \"sample.txt\"");
+  ACTUAL[0] = 'X';
+  CHECK (madvise (ACTUAL, PAGE_SIZE, MADV_DONTNEED) == 0,
+         "madvise mapping MADV_DONTNEED");
+  if (ACTUAL[0] != 'X' || memcmp (ACTUAL + 1, sample + 1, strlen (sample) - 1))
+    fail ("mapping has wrong contents after MADV_DONTNEED");
+  msg ("dropped mapping reloaded with the change");
+  munmap (map);
+  close (handle);
+
+  /* Bad arguments fail the call, not the process. */
+  CHECK (madvise (buf + 1, PAGE_SIZE, MADV_DONTNEED) == -1,
+         "misaligned address");
+  CHECK (madvise (buf, 0, MADV_DONTNEED) == -1, "zero length");
+  CHECK (madvise ((void *) 0xc0000000, PAGE_SIZE, MADV_DONTNEED) == -1,
+         "kernel address");
+  CHECK (madvise ((void *) 0xbffff000, 2 * PAGE_SIZE, MADV_DONTNEED) == -1,
+         "range past user space");
+  CHECK (madvise (buf, PAGE_SIZE, 99) == -1, "bad advice");
+}
@@ -0,0 +1,20 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(madvise) begin
+(madvise) madvise bss MADV_DONTNEED
+(madvise) dropped bss pages read as zeros
+(madvise) open "sample.txt"
+(madvise) mmap "sample.txt"
+(madvise) madvise mapping MADV_DONTNEED
+(madvise) dropped mapping reloaded with the change
+(madvise) misaligned address
+(madvise) zero length
+(madvise) kernel address
+(madvise) range past user space
+(madvise) bad advice
+(madvise) end
+EOF
+pass;
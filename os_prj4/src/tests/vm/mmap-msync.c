@@ -0,0 +1,46 @@
+/* Writes to a file through a mapping, calls msync, and reads the
+   data back with the read system call while the mapping is still
+   in place.  Then changes the mapping again without msync and
+   waits until the flush daemon has written the change back. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/vm/sample.inc"
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define ACTUAL ((char *) 0x10000000)
+
+void
+test_main (void)
+{
+  size_t len = strlen (sample);
+  int handle;
+  mapid_t map;
+  char buf[1024];
+
+  CHECK (create ("sample.txt", len), "create \"sample.txt\"");
+  CHECK ((handle = open ("sample.txt")) > 1, "open \"sample.txt\"");
+  CHECK ((map = mmap (handle, ACTUAL)) != MAP_FAILED, "mmap \"sample.txt\"");
+  memcpy (ACTUAL, sample, len);
+  CHECK (msync (map) == 0, "msync \"sample.txt\"");
+
+  CHECK (read (handle, buf, len) == (int) len, "read \"sample.txt\"");
+  CHECK (!memcmp (buf, sample, len),
+         "compare read data against written data");
+
+  /* Nothing but the flush daemon writes this change back, so if
+     it never does, the test times out. */
+  msg ("change mapping without msync");
+  memset (ACTUAL, 'x', 16);
+  do
+    {
+      seek (handle, 0);
+      read (handle, buf, 16);
+    }
+  while (memcmp (buf, ACTUAL, 16));
+  msg ("flushd wrote back the change");
+
+  munmap (map);
+  close (handle);
+}
@@ -0,0 +1,43 @@
+/* Creates a file whose length is not a multiple of the page
+   size and maps it with MAP_POPULATE, which reads all of it in
+   right away, the last, partial page in the same batch as the
+   others.  Checks the data, and that the rest of the last page
+   reads as zeros. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define PAGE_SIZE 4096
+#define SIZE (3 * PAGE_SIZE + 123)
+#define ACTUAL ((char *) 0x10000000)
+
+static char buf[SIZE];
+
+void
+test_main (void)
+{
+  int handle;
+  mapid_t map;
+  size_t i;
+
+  for (i = 0; i < SIZE; i++)
+    buf[i] = i * 7 + 1;
+  CHECK (create ("populate", SIZE), "create \"populate\"");
+  CHECK ((handle = open ("populate")) > 1, "open \"populate\"");
+  CHECK (write (handle, buf, SIZE) == SIZE, "write \"populate\"");
+
+  CHECK ((map = mmap_flags (handle, ACTUAL, MAP_POPULATE)) != MAP_FAILED,
+         "mmap \"populate\" with MAP_POPULATE");
+  if (memcmp (ACTUAL, buf, SIZE))
+    fail ("read of mmap'd file reported bad data");
+  for (i = SIZE; i < 4 * PAGE_SIZE; i++)
+    if (ACTUAL[i] != 0)
+      fail ("byte %zu of mmap'd region has value %02hhx (should be 0)",
+            i, ACTUAL[i]);
+  msg ("tail of last page is zero");
+
+  munmap (map);
+  close (handle);
+}
@@ -0,0 +1,14 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(mmap-populate) begin
+(mmap-populate) create "populate"
+(mmap-populate) open "populate"
+(mmap-populate) write "populate"
+(mmap-populate) mmap "populate" with MAP_POPULATE
+(mmap-populate) tail of last page is zero
+(mmap-populate) end
+EOF
+pass;
@@ -0,0 +1,19 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+
+our ($test);
+my (@output) = read_text_file ("$test.output");
+fail "RAM above the first 4 MB was not mapped with 4 MB pages\n"
+  if !grep (/^[1-9]\d* MB of RAM mapped with 4 MB pages\./, @output);
+
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(page-big-ram) begin
+(page-big-ram) initialize
+(page-big-ram) read/modify/write pass one
+(page-big-ram) read/modify/write pass two
+(page-big-ram) read pass
+(page-big-ram) end
+EOF
+pass;
@@ -0,0 +1,70 @@
+/* Fills 2 MB of memory, more than fits in RAM, and reads it back
+   a page at a time from the top down, so that swap-in readahead
+   has to find the slots below the faulting one.  Then frees every
+   fourth page with MADV_DONTNEED while readahead may still hold
+   copies of their slots, and rewrites other pages so that the
+   freed slots are reused for new data.  A stale readahead copy
+   would show up as a wrong page in the last pass.  BUF is page
+   aligned so that madvise() can work on single pages of it. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define PAGE_SIZE 4096
+#define SIZE (2 * 1024 * 1024)
+#define PAGE_CNT (SIZE / PAGE_SIZE)
+
+static char buf[SIZE] __attribute__ ((aligned (PAGE_SIZE)));
+
+static void
+fill_page (size_t p, int gen)
+{
+  size_t i;
+
+  for (i = 0; i < PAGE_SIZE; i++)
+    buf[p * PAGE_SIZE + i] = (i * 31 + p * 7 + gen) | 1;
+}
+
+static void
+check_page (size_t p, int gen)
+{
+  size_t i;
+
+  for (i = 0; i < PAGE_SIZE; i++)
+    {
+      char expected = gen < 0 ? 0 : (i * 31 + p * 7 + gen) | 1;
+      if (buf[p * PAGE_SIZE + i] != expected)
+        fail ("byte %zu of page %zu is %d, not %d",
+              i, p, buf[p * PAGE_SIZE + i], expected);
+    }
+}
+
+void
+test_main (void)
+{
+  size_t p;
+
+  msg ("initialize");
+  for (p = 0; p < PAGE_CNT; p++)
+    fill_page (p, 0);
+
+  msg ("read backward");
+  for (p = PAGE_CNT; p-- > 0; )
+    check_page (p, 0);
+
+  msg ("drop and rewrite");
+  for (p = 0; p < PAGE_CNT; p += 4)
+    {
+      check_page (p + 1, 0);
+      if (madvise (buf + p * PAGE_SIZE, PAGE_SIZE, MADV_DONTNEED) != 0)
+        fail ("madvise of page %zu failed", p);
+    }
+  for (p = 2; p < PAGE_CNT; p += 4)
+    fill_page (p, 1);
+
+  msg ("read forward");
+  for (p = 0; p < PAGE_CNT; p++)
+    check_page (p, p % 4 == 0 ? -1 : p % 4 == 2 ? 1 : 0);
+}
@@ -0,0 +1,19 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+
+our ($test);
+my (@output) = read_text_file ("$test.output");
+fail "no swap readahead happened\n"
+  if !grep (/^Swap: [1-9]\d* pages read ahead/, @output);
+
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(page-readahead) begin
+(page-readahead) initialize
+(page-readahead) read backward
+(page-readahead) drop and rewrite
+(page-readahead) read forward
+(page-readahead) end
+EOF
+pass;
@@ -0,0 +1,47 @@
+/* Uses 4.25 MB of bss, a little more than the 4 MB swap disk
+   holds.  The first pass writes all of it, evicting about as much
+   as RAM cannot hold.  The read passes then bring those pages back
+   clean, each still holding its swap slot, while the pages never
+   swapped before are evicted for the first time and need new
+   slots, until swap runs full.  The kernel then has to give up the
+   slots of resident clean pages instead of panicking, without
+   forgetting that those pages are now the only copy. */
+
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define SIZE (4 * 1024 * 1024 + 256 * 1024)
+
+static char buf[SIZE];
+
+static char
+value (size_t i)
+{
+  return i * 257 + i / 4096;
+}
+
+static void
+check_buf (void)
+{
+  size_t i;
+
+  for (i = 0; i < SIZE; i++)
+    if (buf[i] != value (i))
+      fail ("byte %zu is %d, not %d", i, buf[i], value (i));
+}
+
+void
+test_main (void)
+{
+  size_t i;
+
+  msg ("initialize");
+  for (i = 0; i < SIZE; i++)
+    buf[i] = value (i);
+
+  msg ("read pass");
+  check_buf ();
+
+  msg ("read pass");
+  check_buf ();
+}
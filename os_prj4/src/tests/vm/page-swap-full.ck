@@ -0,0 +1,18 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+
+our ($test);
+my (@output) = read_text_file ("$test.output");
+fail "swap never filled up with cached slots\n"
+  if !grep (/[1-9]\d* slots given up when swap was full/, @output);
+
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(page-swap-full) begin
+(page-swap-full) initialize
+(page-swap-full) read pass
+(page-swap-full) read pass
+(page-swap-full) end
+EOF
+pass;
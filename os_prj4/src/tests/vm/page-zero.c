@@ -0,0 +1,67 @@
+/* Reads 1 MB of bss that has never been written, so that every
+   page maps the shared zero page, and checks that it is all
+   zeros.  Then writes every other page, which has to give each
+   of them a frame of its own, and checks that the written pages
+   hold the new data while the rest still read as zeros.  Finally
+   writes the rest and checks the whole buffer. */
+
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define SIZE (1024 * 1024)
+#define PAGE_SIZE 4096
+
+static char buf[SIZE];
+
+static char
+value (size_t i)
+{
+  return (i * 257 + i / PAGE_SIZE) | 1;
+}
+
+static void
+fill_pages (size_t first)
+{
+  size_t i;
+
+  for (i = first * PAGE_SIZE; i < SIZE; i += 2 * PAGE_SIZE)
+    {
+      size_t j;
+
+      for (j = i; j < i + PAGE_SIZE; j++)
+        buf[j] = value (j);
+    }
+}
+
+static void
+check_pages (bool odd_written)
+{
+  size_t i;
+
+  for (i = 0; i < SIZE; i++)
+    {
+      bool written = (i / PAGE_SIZE) % 2 == 0 || odd_written;
+      char expected = written ? value (i) : 0;
+      if (buf[i] != expected)
+        fail ("byte %zu is %d, not %d", i, buf[i], expected);
+    }
+}
+
+void
+test_main (void)
+{
+  size_t i;
+
+  msg ("read untouched bss");
+  for (i = 0; i < SIZE; i++)
+    if (buf[i] != 0)
+      fail ("byte %zu is %d, not 0", i, buf[i]);
+
+  msg ("write even pages");
+  fill_pages (0);
+  check_pages (false);
+
+  msg ("write odd pages");
+  fill_pages (1);
+  check_pages (true);
+}
@@ -0,0 +1,72 @@
+/* Fills 2 MB of memory, more than fits in RAM, so that much of
+   it goes through the compressed swap pool on its way out.  Even
+   pages hold runs that compress well and stay in the pool while
+   it has room; odd pages hold arc4 output, which does not
+   compress and goes to disk.  Checks every page after it comes
+   back, rewrites the compressible ones and checks again. */
+
+#include <string.h>
+#include "tests/arc4.h"
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define PAGE_SIZE 4096
+#define SIZE (2 * 1024 * 1024)
+#define PAGE_CNT (SIZE / PAGE_SIZE)
+
+static char buf[SIZE];
+
+/* Stores in PAGE what page P should hold in generation GEN. */
+static void
+make_page (char *page, size_t p, int gen)
+{
+  if (p % 2 == 0)
+    {
+      /* A few long runs, and the page number. */
+      memset (page, p + gen, PAGE_SIZE / 2);
+      memset (page + PAGE_SIZE / 2, ~(p + gen), PAGE_SIZE / 2);
+      memcpy (page, &p, sizeof p);
+    }
+  else
+    {
+      struct arc4 arc4;
+
+      memset (page, 0, PAGE_SIZE);
+      arc4_init (&arc4, &p, sizeof p);
+      arc4_crypt (&arc4, page, PAGE_SIZE);
+    }
+}
+
+static void
+check_pages (int even_gen)
+{
+  char expected[PAGE_SIZE];
+  size_t p;
+
+  for (p = 0; p < PAGE_CNT; p++)
+    {
+      make_page (expected, p, p % 2 == 0 ? even_gen : 0);
+      if (memcmp (buf + p * PAGE_SIZE, expected, PAGE_SIZE))
+        fail ("page %zu has wrong contents", p);
+    }
+}
+
+void
+test_main (void)
+{
+  size_t p;
+
+  msg ("initialize");
+  for (p = 0; p < PAGE_CNT; p++)
+    make_page (buf + p * PAGE_SIZE, p, 0);
+
+  msg ("read pass");
+  check_pages (0);
+
+  msg ("rewrite compressible pages");
+  for (p = 0; p < PAGE_CNT; p += 2)
+    make_page (buf + p * PAGE_SIZE, p, 1);
+
+  msg ("read pass");
+  check_pages (1);
+}
@@ -0,0 +1,21 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+
+our ($test);
+my (@output) = read_text_file ("$test.output");
+fail "no pages were stored in the compressed swap pool\n"
+  if !grep (/^Zswap: [1-9]\d* pages stored/, @output);
+fail "no pages were loaded back from the compressed swap pool\n"
+  if !grep (/^Zswap: [1-9]\d* loads from memory/, @output);
+
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(page-zswap) begin
+(page-zswap) initialize
+(page-zswap) read pass
+(page-zswap) rewrite compressible pages
+(page-zswap) read pass
+(page-zswap) end
+EOF
+pass;
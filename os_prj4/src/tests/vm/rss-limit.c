@@ -0,0 +1,41 @@
+/* Limits the process to 32 resident pages, far fewer than the
+   512 kB buffer it then encrypts and decrypts, so that it keeps
+   evicting its own pages.  Checks that the result is still
+   right. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/arc4.h"
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define SIZE (512 * 1024)
+#define LIMIT 32
+
+static char buf[SIZE];
+
+void
+test_main (void)
+{
+  struct arc4 arc4;
+  size_t i;
+
+  CHECK (rss_limit (LIMIT) == 0, "set rss limit to %d pages", LIMIT);
+  CHECK (rss_limit (-1) == LIMIT, "read back rss limit");
+
+  msg ("initialize");
+  memset (buf, 0x5a, sizeof buf);
+
+  msg ("read/modify/write pass one");
+  arc4_init (&arc4, "foobar", 6);
+  arc4_crypt (&arc4, buf, SIZE);
+
+  msg ("read/modify/write pass two");
+  arc4_init (&arc4, "foobar", 6);
+  arc4_crypt (&arc4, buf, SIZE);
+
+  msg ("read pass");
+  for (i = 0; i < SIZE; i++)
+    if (buf[i] != 0x5a)
+      fail ("byte %zu != 0x5a", i);
+}
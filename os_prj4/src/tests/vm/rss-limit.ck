@@ -0,0 +1,22 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+
+our ($test);
+my (@output) = read_text_file ("$test.output");
+fail "no frames were evicted by the rss limit\n"
+  if !grep (/^Frame: [1-9]\d* evicted by processes over their rss limit/,
+            @output);
+
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(rss-limit) begin
+(rss-limit) set rss limit to 32 pages
+(rss-limit) read back rss limit
+(rss-limit) initialize
+(rss-limit) read/modify/write pass one
+(rss-limit) read/modify/write pass two
+(rss-limit) read pass
+(rss-limit) end
+EOF
+pass;
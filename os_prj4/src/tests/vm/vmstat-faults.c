@@ -0,0 +1,80 @@
+/* Reads the process's paging statistics with vmstat, forces
+   minor faults, swapping and stack growth, and checks that the
+   counters moved.  Also checks that the system totals cover the
+   process's own, and that vmstat rejects an unknown selector. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define SIZE (2 * 1024 * 1024)
+
+static char buf[SIZE];
+
+/* Touches a few pages of stack below anything used so far. */
+static void __attribute__ ((noinline))
+grow_stack (void)
+{
+  volatile char stack_obj[16 * 1024];
+  size_t i;
+
+  for (i = 0; i < sizeof stack_obj; i += 4096)
+    stack_obj[i] = i;
+}
+
+static uint32_t
+hist_sum (const struct vmstat *st)
+{
+  uint32_t sum = 0;
+  int i;
+
+  for (i = 0; i < VMSTAT_HIST_BUCKETS; i++)
+    sum += st->fault_hist[i];
+  return sum;
+}
+
+static uint32_t
+evictions (const struct vmstat *st)
+{
+  uint32_t sum = 0;
+  int i;
+
+  for (i = 0; i < VMSTAT_EVICT_TYPES; i++)
+    sum += st->evictions[i];
+  return sum;
+}
+
+void
+test_main (void)
+{
+  struct vmstat before, after, global;
+  size_t i;
+
+  CHECK (vmstat (VMSTAT_SELF, &before), "vmstat before");
+
+  /* Fill a buffer bigger than RAM and read it back. */
+  for (i = 0; i < SIZE; i++)
+    buf[i] = i * 257;
+  for (i = 0; i < SIZE; i++)
+    if (buf[i] != (char) (i * 257))
+      fail ("byte %zu has wrong value", i);
+  grow_stack ();
+
+  CHECK (vmstat (VMSTAT_SELF, &after), "vmstat after");
+  CHECK (after.minor_faults > before.minor_faults, "minor faults counted");
+  CHECK (after.major_faults > before.major_faults, "major faults counted");
+  CHECK (after.swap_outs > before.swap_outs, "swap outs counted");
+  CHECK (after.swap_ins > before.swap_ins, "swap ins counted");
+  CHECK (evictions (&after) > evictions (&before), "evictions counted");
+  CHECK (after.stack_growths > before.stack_growths,
+         "stack growth counted");
+  CHECK (hist_sum (&after) == after.minor_faults + after.major_faults,
+         "every fault is in the histogram");
+
+  CHECK (vmstat (VMSTAT_GLOBAL, &global), "vmstat global");
+  CHECK (global.major_faults >= after.major_faults
+         && global.swap_outs >= after.swap_outs,
+         "global counters cover ours");
+  CHECK (!vmstat (42, &global), "vmstat with a bad selector fails");
+}
@@ -0,0 +1,21 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(vmstat-faults) begin
+(vmstat-faults) vmstat before
+(vmstat-faults) vmstat after
+(vmstat-faults) minor faults counted
+(vmstat-faults) major faults counted
+(vmstat-faults) swap outs counted
+(vmstat-faults) swap ins counted
+(vmstat-faults) evictions counted
+(vmstat-faults) stack growth counted
+(vmstat-faults) every fault is in the histogram
+(vmstat-faults) vmstat global
+(vmstat-faults) global counters cover ours
+(vmstat-faults) vmstat with a bad selector fails
+(vmstat-faults) end
+EOF
+pass;
@@ -17,6 +17,7 @@
 #include "devices/rtc.h"
 #include "threads/interrupt.h"
 #include "threads/io.h"
+#include "threads/kmemprof.h"
 #include "threads/loader.h"
 #include "threads/malloc.h"
 #include "threads/palloc.h"
@@ -40,6 +41,8 @@
 
 #include "vm/frame.h"
 #include "vm/swap.h"
+#include "vm/zswap.h"
+#include "vm/vmstat.h"
 
 
 /* Page directory with kernel mappings only. */
@@ -63,6 +66,7 @@ static size_t user_page_limit = SIZE_MAX;
 
 static void bss_init (void);
 static void paging_init (void);
+static bool cpu_has_pse (void);
 
 static char **read_command_line (void);
 static char **parse_options (char **argv);
@@ -122,6 +126,7 @@ main (void)
 
   /* Start thread scheduler and enable interrupts. */
   thread_start ();
+  palloc_start_zero_thread ();
   serial_init_queue ();
   timer_calibrate ();
 
@@ -160,13 +165,31 @@ bss_init (void)
 /* Populates the base page directory and page table with the
    kernel virtual mapping, and then sets up the CPU to use the
    new page directory.  Points init_page_dir to the page
-   directory it creates. */
+   directory it creates.
+
+   If the CPU supports page size extensions, every 4 MB of RAM
+   that does not hold kernel text is mapped by a single 4 MB
+   page directory entry, which saves the page tables and, more
+   importantly, TLB entries.  The 4 MB holding the kernel text
+   keeps 4 kB pages so that the text can stay read-only.  That
+   block is the first one, so with 4 MB of RAM or less nothing is
+   mapped this way; the boot message says how much was. */
 static void
 paging_init (void)
 {
   uint32_t *pd, *pt;
   size_t page;
+  size_t large_cnt = 0;
   extern char _start, _end_kernel_text;
+  bool pse = cpu_has_pse ();
+
+  if (pse)
+    {
+      /* Turn on CR4.PSE.  See [IA32-v3a] 3.6.1 "Paging Options". */
+      uint32_t cr4;
+      asm volatile ("movl %%cr4, %0" : "=r" (cr4));
+      asm volatile ("movl %0, %%cr4" : : "r" (cr4 | 0x10));
+    }
 
   pd = init_page_dir = palloc_get_page (PAL_ASSERT | PAL_ZERO);
   pt = NULL;
@@ -178,6 +201,15 @@ paging_init (void)
       size_t pte_idx = pt_no (vaddr);
       bool in_kernel_text = &_start <= vaddr && vaddr < &_end_kernel_text;
 
+      if (pse && pte_idx == 0 && page + PTSPAN / PGSIZE <= init_ram_pages
+          && !(vaddr < &_end_kernel_text && &_start < vaddr + PTSPAN))
+        {
+          pd[pde_idx] = pde_create_kernel_large (vaddr, true);
+          large_cnt++;
+          page += PTSPAN / PGSIZE - 1;
+          continue;
+        }
+
       if (pd[pde_idx] == 0)
         {
           pt = palloc_get_page (PAL_ASSERT | PAL_ZERO);
@@ -193,6 +225,21 @@ paging_init (void)
      to/from Control Registers" and [IA32-v3a] 3.7.5 "Base Address
      of the Page Directory". */
   asm volatile ("movl %0, %%cr3" : : "r" (vtop (init_page_dir)));
+
+  if (pse)
+    printf ("%zu MB of RAM mapped with 4 MB pages.\n",
+            large_cnt * (PTSPAN >> 20));
+}
+
+/* Returns true if the CPU supports 4 MB pages (CPUID.1:EDX.PSE).
+   See [IA32-v2a] "CPUID--CPU Identification". */
+static bool
+cpu_has_pse (void)
+{
+  uint32_t eax = 1, ebx, ecx, edx;
+
+  asm ("cpuid" : "+a" (eax), "=b" (ebx), "=c" (ecx), "=d" (edx));
+  return (edx & (1 << 3)) != 0;
 }
 
 /* Breaks the kernel command line into words and returns them as
@@ -257,12 +304,26 @@ parse_options (char **argv)
 #ifdef VM
       else if (!strcmp (name, "-swap"))
         swap_bdev_name = value;
+      else if (!strcmp (name, "-vmpolicy"))
+        {
+          if (value == NULL || !frame_table_set_policy (value))
+            PANIC ("unknown page replacement policy `%s'",
+                   value != NULL ? value : "");
+        }
+      else if (!strcmp (name, "-zswap"))
+        zswap_pool_pages = atoi (value);
+      else if (!strcmp (name, "-vmstat"))
+        vmstat_enabled = true;
+      else if (!strcmp (name, "-rss"))
+        rss_default_limit = atoi (value);
 #endif
 #endif
       else if (!strcmp (name, "-rs"))
         random_init (atoi (value));
       else if (!strcmp (name, "-mlfqs"))
         thread_mlfqs = true;
+      else if (!strcmp (name, "-kmemprof"))
+        kmemprof_enabled = true;
 #ifndef USERPROG
       else if (!strcmp (name, "-aging"))
         thread_prior_aging = true;
@@ -386,10 +447,15 @@ usage (void)
           "  -scratch=BDEV      Use BDEV for scratch instead of default.\n"
 #ifdef VM
           "  -swap=BDEV         Use BDEV for swap instead of default.\n"
+          "  -vmpolicy=POLICY   Page replacement: clock (default), esc, 2q.\n"
+          "  -zswap=PAGES       Compress swapped pages into PAGES of RAM (0=off).\n"
+          "  -vmstat            Print paging statistics of each process at exit.\n"
+          "  -rss=PAGES         Limit each process to PAGES resident pages.\n"
 #endif
 #endif
           "  -rs=SEED           Set random number seed to SEED.\n"
           "  -mlfqs             Use multi-level feedback queue scheduler.\n"
+          "  -kmemprof          Report kernel allocations by call site.\n"
 #ifdef USERPROG
           "  -ul=COUNT          Limit user memory to COUNT pages.\n"
 #endif
@@ -0,0 +1,165 @@
+#include "threads/kmemprof.h"
+#include <debug.h>
+#include <inttypes.h>
+#include <stdint.h>
+#include <stdio.h>
+#include "threads/interrupt.h"
+
+/* Kernel heap profiler.
+
+   When enabled with -kmemprof, malloc() and palloc record every
+   allocation against the return address of their caller.  For
+   each such call site we keep the number and size of blocks that
+   are still live, the peak of live bytes and the total number of
+   allocations.  The report printed at shutdown is sorted by live
+   bytes, so leaks float to the top, and ends with the list of
+   call sites in a form that utils/backtrace accepts.
+
+   The allocators themselves remember which site an allocation
+   belongs to (malloc in a small header in front of the block,
+   palloc in a per-page array), and hand the site number back to
+   kmemprof_free().
+
+   The site table is fixed-size and static, because we cannot
+   allocate memory while tracking an allocation.  It is protected
+   by disabling interrupts rather than by a lock, because pages
+   are freed from thread_schedule_tail() with interrupts off. */
+
+/* Maximum number of distinct call sites.  Allocations from
+   further sites are lumped together in the last entry. */
+#define SITE_CNT 256
+
+/* A call site. */
+struct site
+  {
+    const void *caller;         /* Return address of the caller. */
+    enum kmemprof_kind kind;    /* Allocator called. */
+    bool in_use;                /* True if this entry is taken. */
+    long long live_cnt;         /* Blocks not yet freed. */
+    long long live_bytes;       /* Bytes not yet freed. */
+    long long peak_bytes;       /* Maximum of live_bytes. */
+    long long total_cnt;        /* Number of allocations. */
+  };
+
+bool kmemprof_enabled;
+
+static struct site sites[SITE_CNT];
+
+static int find_site (enum kmemprof_kind, const void *caller);
+
+/* Records the allocation of SIZE bytes by the allocator KIND
+   called from CALLER.  Returns the site number to pass to
+   kmemprof_free() when the block is freed. */
+int
+kmemprof_alloc (enum kmemprof_kind kind, const void *caller, size_t size)
+{
+  enum intr_level old_level;
+  struct site *s;
+  int idx;
+
+  ASSERT (kmemprof_enabled);
+
+  old_level = intr_disable ();
+  idx = find_site (kind, caller);
+  s = &sites[idx];
+  s->live_cnt++;
+  s->live_bytes += size;
+  s->total_cnt++;
+  if (s->live_bytes > s->peak_bytes)
+    s->peak_bytes = s->live_bytes;
+  intr_set_level (old_level);
+
+  return idx;
+}
+
+/* Records that a SIZE-byte block allocated at SITE was freed. */
+void
+kmemprof_free (int site, size_t size)
+{
+  enum intr_level old_level;
+
+  ASSERT (site >= 0 && site < SITE_CNT);
+
+  old_level = intr_disable ();
+  sites[site].live_cnt--;
+  sites[site].live_bytes -= size;
+  intr_set_level (old_level);
+}
+
+/* Prints the per-call-site report, if profiling is enabled. */
+void
+kmemprof_print_report (void)
+{
+  static int order[SITE_CNT];
+  int cnt = 0;
+  int i, j;
+
+  if (!kmemprof_enabled)
+    return;
+
+  /* Sort the sites in use by live bytes, then by total
+     allocations, largest first. */
+  for (i = 0; i < SITE_CNT; i++)
+    if (sites[i].in_use)
+      {
+        const struct site *s = &sites[i];
+        for (j = cnt; j > 0; j--)
+          {
+            const struct site *t = &sites[order[j - 1]];
+            if (t->live_bytes > s->live_bytes
+                || (t->live_bytes == s->live_bytes
+                    && t->total_cnt >= s->total_cnt))
+              break;
+            order[j] = order[j - 1];
+          }
+        order[j] = i;
+        cnt++;
+      }
+
+  printf ("Kmemprof: %d call sites\n", cnt);
+  printf ("  %-6s  %-10s  %8s  %10s  %10s  %8s\n",
+          "kind", "call site", "live", "live bytes", "peak bytes", "total");
+  for (i = 0; i < cnt; i++)
+    {
+      const struct site *s = &sites[order[i]];
+      printf ("  %-6s  %#010"PRIxPTR"  %8lld  %10lld  %10lld  %8lld\n",
+              s->kind == KMEMPROF_MALLOC ? "malloc" : "palloc",
+              (uintptr_t) s->caller, s->live_cnt, s->live_bytes,
+              s->peak_bytes, s->total_cnt);
+    }
+
+  printf ("Kmemprof call sites (symbolize with utils/backtrace):\n");
+  for (i = 0; i < cnt; i++)
+    printf (" %p", sites[order[i]].caller);
+  printf ("\n");
+}
+
+/* Returns the index of the site for allocator KIND called from
+   CALLER, claiming a free entry if there is none yet.  Must be
+   called with interrupts off. */
+static int
+find_site (enum kmemprof_kind kind, const void *caller)
+{
+  int start = ((uintptr_t) caller * 2654435761u + kind) % (SITE_CNT - 1);
+  int i = start;
+
+  do
+    {
+      struct site *s = &sites[i];
+      if (!s->in_use)
+        {
+          s->in_use = true;
+          s->caller = caller;
+          s->kind = kind;
+          return i;
+        }
+      if (s->caller == caller && s->kind == kind)
+        return i;
+      i = (i + 1) % (SITE_CNT - 1);
+    }
+  while (i != start);
+
+  /* Table full: use the overflow entry. */
+  sites[SITE_CNT - 1].in_use = true;
+  return SITE_CNT - 1;
+}
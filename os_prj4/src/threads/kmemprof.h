@@ -0,0 +1,21 @@
+#ifndef THREADS_KMEMPROF_H
+#define THREADS_KMEMPROF_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/* Kinds of allocation tracked by the profiler. */
+enum kmemprof_kind
+  {
+    KMEMPROF_MALLOC,            /* malloc(), calloc(), realloc(). */
+    KMEMPROF_PALLOC             /* palloc_get_page/multiple(). */
+  };
+
+/* -kmemprof: Track kernel allocations per call site? */
+extern bool kmemprof_enabled;
+
+int kmemprof_alloc (enum kmemprof_kind, const void *caller, size_t size);
+void kmemprof_free (int site, size_t size);
+void kmemprof_print_report (void);
+
+#endif /* threads/kmemprof.h */
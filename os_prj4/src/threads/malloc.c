@@ -5,6 +5,7 @@
 #include <stdint.h>
 #include <stdio.h>
 #include <string.h>
+#include "threads/kmemprof.h"
 #include "threads/palloc.h"
 #include "threads/synch.h"
 #include "threads/vaddr.h"
@@ -32,7 +33,11 @@
    because they're too big to fit in a single page with a
    descriptor.  We handle those by allocating contiguous pages
    with the page allocator and sticking the allocation size at
-   the beginning of the allocated block's arena header. */
+   the beginning of the allocated block's arena header.
+
+   With -kmemprof, every block carries a small header in front of
+   it that records the requested size and the call site it was
+   charged to, so that free() can credit it back. */
 
 /* Descriptor. */
 struct desc
@@ -60,12 +65,22 @@ struct block
     struct list_elem free_elem; /* Free list element. */
   };
 
+/* Profiling header, in front of each block under -kmemprof. */
+struct prof_tag
+  {
+    int site;                   /* Site number from kmemprof. */
+    size_t size;                /* Requested size in bytes. */
+  };
+
 /* Our set of descriptors. */
 static struct desc descs[10];   /* Descriptors. */
 static size_t desc_cnt;         /* Number of descriptors. */
 
 static struct arena *block_to_arena (struct block *);
 static struct block *arena_to_block (struct arena *, size_t idx);
+static void *malloc_at (size_t, const void *caller);
+static void *raw_malloc (size_t);
+static void raw_free (void *);
 
 /* Initializes the malloc() descriptors. */
 void
@@ -89,14 +104,39 @@ malloc_init (void)
 void *
 malloc (size_t size) 
 {
-  struct desc *d;
-  struct block *b;
-  struct arena *a;
+  return malloc_at (size, __builtin_return_address (0));
+}
+
+/* Like malloc(), but charges the block to CALLER if profiling. */
+static void *
+malloc_at (size_t size, const void *caller)
+{
+  struct prof_tag *tag;
 
   /* A null pointer satisfies a request for 0 bytes. */
   if (size == 0)
     return NULL;
 
+  if (!kmemprof_enabled)
+    return raw_malloc (size);
+
+  tag = raw_malloc (size + sizeof *tag);
+  if (tag == NULL)
+    return NULL;
+  tag->site = kmemprof_alloc (KMEMPROF_MALLOC, caller, size);
+  tag->size = size;
+  return tag + 1;
+}
+
+/* Obtains and returns a new block of at least SIZE bytes,
+   without any profiling header. */
+static void *
+raw_malloc (size_t size) 
+{
+  struct desc *d;
+  struct block *b;
+  struct arena *a;
+
   /* Find the smallest descriptor that satisfies a SIZE-byte
      request. */
   for (d = descs; d < descs + desc_cnt; d++)
@@ -167,7 +207,7 @@ calloc (size_t a, size_t b)
     return NULL;
 
   /* Allocate and zero memory. */
-  p = malloc (size);
+  p = malloc_at (size, __builtin_return_address (0));
   if (p != NULL)
     memset (p, 0, size);
 
@@ -179,9 +219,14 @@ static size_t
 block_size (void *block) 
 {
   struct block *b = block;
-  struct arena *a = block_to_arena (b);
-  struct desc *d = a->desc;
+  struct arena *a;
+  struct desc *d;
 
+  if (kmemprof_enabled)
+    return ((struct prof_tag *) block - 1)->size;
+
+  a = block_to_arena (b);
+  d = a->desc;
   return d != NULL ? d->block_size : PGSIZE * a->free_cnt - pg_ofs (block);
 }
 
@@ -201,7 +246,7 @@ realloc (void *old_block, size_t new_size)
     }
   else 
     {
-      void *new_block = malloc (new_size);
+      void *new_block = malloc_at (new_size, __builtin_return_address (0));
       if (old_block != NULL && new_block != NULL)
         {
           size_t old_size = block_size (old_block);
@@ -217,6 +262,20 @@ realloc (void *old_block, size_t new_size)
    malloc(), calloc(), or realloc(). */
 void
 free (void *p) 
+{
+  if (p != NULL && kmemprof_enabled)
+    {
+      struct prof_tag *tag = (struct prof_tag *) p - 1;
+      kmemprof_free (tag->site, tag->size);
+      p = tag;
+    }
+  raw_free (p);
+}
+
+/* Frees block P, which must have been obtained from
+   raw_malloc(). */
+static void
+raw_free (void *p) 
 {
   if (p != NULL)
     {
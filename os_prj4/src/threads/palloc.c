@@ -7,8 +7,11 @@
 #include <stdint.h>
 #include <stdio.h>
 #include <string.h>
+#include "threads/interrupt.h"
+#include "threads/kmemprof.h"
 #include "threads/loader.h"
 #include "threads/synch.h"
+#include "threads/thread.h"
 #include "threads/vaddr.h"
 
 /* Page allocator.  Hands out memory in page-size (or
@@ -23,22 +26,110 @@
 
    By default, half of system RAM is given to the kernel pool and
    half to the user pool.  That should be huge overkill for the
-   kernel pool, but that's just fine for demonstration purposes. */
+   kernel pool, but that's just fine for demonstration purposes.
+
+   The split is not final, though.  When a pool runs dry it may
+   borrow a chunk of LOAN_PAGES contiguous pages from the other
+   pool, as long as the lender keeps at least LEND_LOW_WATER free
+   pages for itself.  The chunk stays marked used in the lender's
+   bitmap and is handed out by the borrower through the chunk's
+   own small bitmap.  A chunk goes back to its lender once it is
+   entirely free and either the borrower has RETURN_HIGH_WATER
+   free pages of its own again or the lender needs it.
+
+   Pages in use scattered across a pool can leave no contiguous
+   run big enough for a multi-page request (or a chunk to lend)
+   even though plenty of pages are free.  Virtual memory can
+   register a compaction hook that moves user pages to the top of
+   the user pool (see PAL_HIGH); we call it and retry when a
+   multi-page request fails.
+
+   A low-priority "pzero" thread keeps a stock of free pages in
+   each pool that are already filled with zeros, so that PAL_ZERO
+   requests can usually skip the memset.  A pre-zeroed page is
+   still free: any request may take it, it just loses its zeroed
+   status when it does.
+
+   Under -kmemprof, page_sites[] remembers, for each physical
+   page that begins an allocation, the call site it is charged
+   to. */
+
+/* Pre-zeroed page watermarks, per pool.  The zeroing thread is
+   woken when a pool drops below ZERO_LOW_WATER zeroed pages and
+   keeps going until it has ZERO_HIGH_WATER of them (or runs out
+   of free pages). */
+#define ZERO_LOW_WATER 8
+#define ZERO_HIGH_WATER 32
+
+/* Lending between pools. */
+#define LOAN_PAGES 64           /* Pages per lent chunk. */
+#define LEND_LOW_WATER 64       /* Free pages a lender always keeps. */
+#define RETURN_HIGH_WATER 128   /* Borrower's free pages to give back. */
+#define MAX_LOANS 128           /* Chunks that can be out at once. */
 
 /* A memory pool. */
 struct pool
   {
     struct lock lock;                   /* Mutual exclusion. */
     struct bitmap *used_map;            /* Bitmap of free pages. */
+    struct bitmap *zero_map;            /* Free pages known to be zero. */
+    size_t zero_cnt;                    /* Number of bits set in zero_map. */
+    size_t free_cnt;                    /* Number of bits clear in used_map. */
     uint8_t *base;                      /* Base of pool. */
+
+    /* Statistics. */
+    long long loans_taken;              /* Chunks borrowed from the other. */
+    long long zero_hits;                /* PAL_ZERO served pre-zeroed. */
+    long long zero_misses;              /* PAL_ZERO that had to memset. */
   };
 
 /* Two pools: one for kernel data, one for user pages. */
 static struct pool kernel_pool, user_pool;
 
+/* A chunk of pages lent by one pool to the other.
+   Protected by disabling interrupts, because pages may be freed
+   with interrupts off (see thread_schedule_tail()). */
+struct loan
+  {
+    struct pool *lender;                /* Pool the pages belong to. */
+    struct pool *borrower;              /* Null if this loan is unused. */
+    size_t lender_idx;                  /* First page in lender's used_map. */
+    uint8_t *base;                      /* First page. */
+    struct bitmap *used_map;            /* Pages handed out by borrower. */
+    size_t free_cnt;                    /* Number of bits clear in used_map. */
+    uint32_t map_buf[8];                /* Storage for used_map. */
+  };
+
+static struct loan loans[MAX_LOANS];
+
+/* Compaction hook, see palloc_set_compact_hook(). */
+static palloc_compact_func *compact_hook;
+
+/* Per physical page kmemprof site numbers, if profiling. */
+static uint16_t *page_sites;
+
+/* Wakes up the zeroing thread.  zero_wakeup_pending keeps us from
+   upping the semaphore more than once per round. */
+static struct semaphore zero_sema;
+static bool zero_thread_started;
+static bool zero_wakeup_pending;
+
 static void init_pool (struct pool *, void *base, size_t page_cnt,
                        const char *name);
 static bool page_from_pool (const struct pool *, void *page);
+static void *take_from_pool (struct pool *, enum palloc_flags,
+                             size_t page_cnt, size_t *zeroed);
+static void *take_from_loans (struct pool *, size_t page_cnt);
+static bool borrow_chunk (struct pool *borrower);
+static void reclaim_chunks (struct pool *lender);
+static struct loan *loan_of (void *page);
+static void end_loan (struct loan *);
+static struct pool *other_pool (struct pool *);
+static void *get_multiple (enum palloc_flags, size_t page_cnt,
+                           const void *caller);
+static void wake_zero_thread (void);
+static bool zero_one_page (struct pool *);
+static thread_func zero_thread NO_RETURN;
 
 /* Initializes the page allocator.  At most USER_PAGE_LIMIT
    pages are put into the user pool. */
@@ -49,8 +140,20 @@ palloc_init (size_t user_page_limit)
   uint8_t *free_start = ptov (1024 * 1024);
   uint8_t *free_end = ptov (init_ram_pages * PGSIZE);
   size_t free_pages = (free_end - free_start) / PGSIZE;
-  size_t user_pages = free_pages / 2;
+  size_t user_pages;
   size_t kernel_pages;
+
+  /* Set aside the profiler's page_sites[] array first. */
+  if (kmemprof_enabled)
+    {
+      size_t site_pages = DIV_ROUND_UP (init_ram_pages * sizeof *page_sites,
+                                        PGSIZE);
+      page_sites = (uint16_t *) free_start;
+      free_start += site_pages * PGSIZE;
+      free_pages -= site_pages;
+    }
+
+  user_pages = free_pages / 2;
   if (user_pages > user_page_limit)
     user_pages = user_page_limit;
   kernel_pages = free_pages - user_pages;
@@ -59,6 +162,18 @@ palloc_init (size_t user_page_limit)
   init_pool (&kernel_pool, free_start, kernel_pages, "kernel pool");
   init_pool (&user_pool, free_start + kernel_pages * PGSIZE,
              user_pages, "user pool");
+
+  sema_init (&zero_sema, 0);
+}
+
+/* Starts the background thread that pre-zeroes free pages.
+   Must be called after thread_start(). */
+void
+palloc_start_zero_thread (void)
+{
+  thread_create ("pzero", PRI_MIN, zero_thread, NULL);
+  zero_thread_started = true;
+  wake_zero_thread ();
 }
 
 /* Obtains and returns a group of PAGE_CNT contiguous free pages.
@@ -69,27 +184,63 @@ palloc_init (size_t user_page_limit)
    FLAGS, in which case the kernel panics. */
 void *
 palloc_get_multiple (enum palloc_flags flags, size_t page_cnt)
+{
+  return get_multiple (flags, page_cnt, __builtin_return_address (0));
+}
+
+/* Does the work of palloc_get_multiple(), charging the pages to
+   CALLER if profiling. */
+static void *
+get_multiple (enum palloc_flags flags, size_t page_cnt, const void *caller)
 {
   struct pool *pool = flags & PAL_USER ? &user_pool : &kernel_pool;
   void *pages;
-  size_t page_idx;
+  size_t zeroed = 0;
 
   if (page_cnt == 0)
     return NULL;
 
-  lock_acquire (&pool->lock);
-  page_idx = bitmap_scan_and_flip (pool->used_map, 0, page_cnt, false);
-  lock_release (&pool->lock);
+  pages = take_from_pool (pool, flags, page_cnt, &zeroed);
+  if (pages == NULL)
+    {
+      /* Take back any chunk we lent out that is idle, then try
+         our own pool again before borrowing from the other. */
+      reclaim_chunks (pool);
+      pages = take_from_pool (pool, flags, page_cnt, &zeroed);
+    }
+  if (pages == NULL && page_cnt <= LOAN_PAGES && !(flags & PAL_HIGH))
+    {
+      bool borrowed = true;
 
-  if (page_idx != BITMAP_ERROR)
-    pages = pool->base + PGSIZE * page_idx;
-  else
-    pages = NULL;
+      pages = take_from_loans (pool, page_cnt);
+      if (pages == NULL && borrow_chunk (pool))
+        pages = take_from_loans (pool, page_cnt);
+      if (pages == NULL && page_cnt > 1 && compact_hook != NULL)
+        {
+          /* Fragmented: compact the user pool and try once more,
+             both our own pool and a fresh chunk. */
+          compact_hook ();
+          pages = take_from_pool (pool, flags, page_cnt, &zeroed);
+          borrowed = false;
+          if (pages == NULL && borrow_chunk (pool))
+            {
+              pages = take_from_loans (pool, page_cnt);
+              borrowed = true;
+            }
+        }
+
+      /* Borrowed pages are never known to be zero. */
+      if (pages != NULL && borrowed && (flags & PAL_ZERO))
+        pool->zero_misses++;
+    }
 
   if (pages != NULL) 
     {
-      if (flags & PAL_ZERO)
+      if ((flags & PAL_ZERO) && zeroed != page_cnt)
         memset (pages, 0, PGSIZE * page_cnt);
+      if (kmemprof_enabled)
+        page_sites[vtop (pages) >> PGBITS]
+          = kmemprof_alloc (KMEMPROF_PALLOC, caller, PGSIZE * page_cnt);
     }
   else 
     {
@@ -100,6 +251,271 @@ palloc_get_multiple (enum palloc_flags flags, size_t page_cnt)
   return pages;
 }
 
+/* Takes PAGE_CNT contiguous pages from POOL's own pages, and
+   stores in *ZEROED how many of them were already zeroed.
+   Returns the first page, or a null pointer on failure. */
+static void *
+take_from_pool (struct pool *pool, enum palloc_flags flags, size_t page_cnt,
+                size_t *zeroed)
+{
+  enum intr_level old_level;
+  size_t page_idx;
+
+  *zeroed = 0;
+  ASSERT (!(flags & PAL_HIGH) || page_cnt == 1);
+
+  lock_acquire (&pool->lock);
+  if (flags & PAL_HIGH)
+    {
+      /* Take the free page closest to the top of the pool. */
+      page_idx = bitmap_size (pool->used_map);
+      while (page_idx-- > 0)
+        if (!bitmap_test (pool->used_map, page_idx))
+          break;
+      if (page_idx == (size_t) -1)
+        page_idx = BITMAP_ERROR;
+      else
+        bitmap_mark (pool->used_map, page_idx);
+    }
+  else if ((flags & PAL_ZERO) && page_cnt == 1 && pool->zero_cnt > 0)
+    {
+      /* Take a page that is already zeroed. */
+      page_idx = bitmap_scan (pool->zero_map, 0, 1, true);
+      ASSERT (page_idx != BITMAP_ERROR);
+      bitmap_mark (pool->used_map, page_idx);
+    }
+  else
+    page_idx = bitmap_scan_and_flip (pool->used_map, 0, page_cnt, false);
+
+  /* Whatever we took is no longer a free zeroed page. */
+  if (page_idx != BITMAP_ERROR)
+    {
+      *zeroed = bitmap_count (pool->zero_map, page_idx, page_cnt, true);
+      bitmap_set_multiple (pool->zero_map, page_idx, page_cnt, false);
+      pool->zero_cnt -= *zeroed;
+      if (flags & PAL_ZERO)
+        {
+          if (*zeroed == page_cnt)
+            pool->zero_hits++;
+          else
+            pool->zero_misses++;
+        }
+      old_level = intr_disable ();
+      pool->free_cnt -= page_cnt;
+      intr_set_level (old_level);
+    }
+  lock_release (&pool->lock);
+
+  if (page_idx == BITMAP_ERROR)
+    return NULL;
+
+  if (pool->zero_cnt < ZERO_LOW_WATER)
+    wake_zero_thread ();
+  return pool->base + PGSIZE * page_idx;
+}
+
+/* Takes PAGE_CNT contiguous pages from the chunks POOL has
+   borrowed.  Returns the first page, or a null pointer if no
+   chunk has room. */
+static void *
+take_from_loans (struct pool *pool, size_t page_cnt)
+{
+  enum intr_level old_level = intr_disable ();
+  void *pages = NULL;
+  struct loan *l;
+
+  for (l = loans; l < loans + MAX_LOANS; l++)
+    if (l->borrower == pool && l->free_cnt >= page_cnt)
+      {
+        size_t idx = bitmap_scan_and_flip (l->used_map, 0, page_cnt, false);
+        if (idx != BITMAP_ERROR)
+          {
+            l->free_cnt -= page_cnt;
+            pages = l->base + PGSIZE * idx;
+            break;
+          }
+      }
+  intr_set_level (old_level);
+
+  return pages;
+}
+
+/* Borrows a chunk of LOAN_PAGES pages for BORROWER from the other
+   pool, if the other pool can spare it.  Returns true if
+   successful. */
+static bool
+borrow_chunk (struct pool *borrower)
+{
+  struct pool *lender = other_pool (borrower);
+  enum intr_level old_level;
+  struct loan *l;
+  size_t idx;
+  size_t zeroed;
+
+  lock_acquire (&lender->lock);
+  if (lender->free_cnt < LOAN_PAGES + LEND_LOW_WATER)
+    {
+      lock_release (&lender->lock);
+      return false;
+    }
+  idx = bitmap_scan_and_flip (lender->used_map, 0, LOAN_PAGES, false);
+  if (idx == BITMAP_ERROR)
+    {
+      lock_release (&lender->lock);
+      return false;
+    }
+  zeroed = bitmap_count (lender->zero_map, idx, LOAN_PAGES, true);
+  bitmap_set_multiple (lender->zero_map, idx, LOAN_PAGES, false);
+  lender->zero_cnt -= zeroed;
+  old_level = intr_disable ();
+  lender->free_cnt -= LOAN_PAGES;
+  intr_set_level (old_level);
+  lock_release (&lender->lock);
+
+  old_level = intr_disable ();
+  for (l = loans; l < loans + MAX_LOANS; l++)
+    if (l->borrower == NULL)
+      break;
+  if (l < loans + MAX_LOANS)
+    {
+      l->lender = lender;
+      l->borrower = borrower;
+      l->lender_idx = idx;
+      l->base = lender->base + PGSIZE * idx;
+      l->used_map = bitmap_create_in_buf (LOAN_PAGES, l->map_buf,
+                                          sizeof l->map_buf);
+      l->free_cnt = LOAN_PAGES;
+      borrower->loans_taken++;
+    }
+  else
+    {
+      /* Out of loan slots: give the pages straight back. */
+      bitmap_set_multiple (lender->used_map, idx, LOAN_PAGES, false);
+      lender->free_cnt += LOAN_PAGES;
+    }
+  intr_set_level (old_level);
+
+  return l < loans + MAX_LOANS;
+}
+
+/* Takes back every chunk LENDER has lent out that the borrower
+   is not using at all. */
+static void
+reclaim_chunks (struct pool *lender)
+{
+  enum intr_level old_level = intr_disable ();
+  struct loan *l;
+
+  for (l = loans; l < loans + MAX_LOANS; l++)
+    if (l->borrower != NULL && l->lender == lender
+        && l->free_cnt == LOAN_PAGES)
+      end_loan (l);
+  intr_set_level (old_level);
+}
+
+/* Returns the loan that PAGE was handed out from, or a null
+   pointer if PAGE belongs to its own pool.  Must be called with
+   interrupts off. */
+static struct loan *
+loan_of (void *page)
+{
+  struct loan *l;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  for (l = loans; l < loans + MAX_LOANS; l++)
+    if (l->borrower != NULL && (uint8_t *) page >= l->base
+        && (uint8_t *) page < l->base + PGSIZE * LOAN_PAGES)
+      return l;
+  return NULL;
+}
+
+/* Returns the pages of loan L, which must be entirely free, to
+   its lender.  Must be called with interrupts off. */
+static void
+end_loan (struct loan *l)
+{
+  ASSERT (intr_get_level () == INTR_OFF);
+  ASSERT (l->free_cnt == LOAN_PAGES);
+
+  bitmap_set_multiple (l->lender->used_map, l->lender_idx, LOAN_PAGES, false);
+  l->lender->free_cnt += LOAN_PAGES;
+  l->borrower = NULL;
+}
+
+/* Returns true if the pool selected by FLAGS has PAGE_CNT free
+   pages of its own but not PAGE_CNT contiguous ones. */
+bool
+palloc_fragmented (enum palloc_flags flags, size_t page_cnt)
+{
+  struct pool *pool = flags & PAL_USER ? &user_pool : &kernel_pool;
+  bool fragmented;
+
+  lock_acquire (&pool->lock);
+  fragmented = (pool->free_cnt >= page_cnt
+                && bitmap_scan (pool->used_map, 0, page_cnt, false)
+                   == BITMAP_ERROR);
+  lock_release (&pool->lock);
+
+  return fragmented;
+}
+
+/* Registers HOOK to be called when a multi-page allocation fails
+   for lack of contiguous pages. */
+void
+palloc_set_compact_hook (palloc_compact_func *hook)
+{
+  compact_hook = hook;
+}
+
+/* Returns the pool that lends to, and borrows from, POOL. */
+static struct pool *
+other_pool (struct pool *pool)
+{
+  return pool == &user_pool ? &kernel_pool : &user_pool;
+}
+
+/* Returns the number of pages that an allocation with FLAGS could
+   still obtain without anything being freed: free pages in its
+   own pool and in the chunks it has borrowed, plus the chunks
+   the other pool could still lend it.  Virtual memory uses this
+   to decide when it really has to start evicting. */
+size_t
+palloc_free_cnt (enum palloc_flags flags)
+{
+  struct pool *pool = flags & PAL_USER ? &user_pool : &kernel_pool;
+  struct pool *other = other_pool (pool);
+  enum intr_level old_level = intr_disable ();
+  size_t cnt = pool->free_cnt;
+  struct loan *l;
+
+  for (l = loans; l < loans + MAX_LOANS; l++)
+    if (l->borrower == pool)
+      cnt += l->free_cnt;
+    else if (l->borrower == other && l->free_cnt == LOAN_PAGES)
+      cnt += LOAN_PAGES;
+  if (other->free_cnt >= LOAN_PAGES + LEND_LOW_WATER)
+    cnt += (other->free_cnt - LEND_LOW_WATER) / LOAN_PAGES * LOAN_PAGES;
+  intr_set_level (old_level);
+
+  return cnt;
+}
+
+/* Returns the first page that either pool can hand out and
+   stores in *PAGE_CNT the number of pages from there to the end
+   of the user pool, and in *USER_IDX the index of the user pool's
+   first page in that range.  Because the pools lend each other
+   pages, a user page may lie anywhere in the range, but below
+   *USER_IDX only in a chunk the kernel pool has lent out. */
+void *
+palloc_range (size_t *page_cnt, size_t *user_idx)
+{
+  uint8_t *end = user_pool.base + bitmap_size (user_pool.used_map) * PGSIZE;
+  *page_cnt = (end - kernel_pool.base) / PGSIZE;
+  *user_idx = (user_pool.base - kernel_pool.base) / PGSIZE;
+  return kernel_pool.base;
+}
+
 /* Obtains a single free page and returns its kernel virtual
    address.
    If PAL_USER is set, the page is obtained from the user pool,
@@ -110,20 +526,47 @@ palloc_get_multiple (enum palloc_flags flags, size_t page_cnt)
 void *
 palloc_get_page (enum palloc_flags flags) 
 {
-  return palloc_get_multiple (flags, 1);
+  return get_multiple (flags, 1, __builtin_return_address (0));
 }
 
 /* Frees the PAGE_CNT pages starting at PAGES. */
 void
 palloc_free_multiple (void *pages, size_t page_cnt) 
 {
+  enum intr_level old_level;
   struct pool *pool;
+  struct loan *l;
   size_t page_idx;
 
   ASSERT (pg_ofs (pages) == 0);
   if (pages == NULL || page_cnt == 0)
     return;
 
+  if (kmemprof_enabled)
+    kmemprof_free (page_sites[vtop (pages) >> PGBITS], PGSIZE * page_cnt);
+
+#ifndef NDEBUG
+  memset (pages, 0xcc, PGSIZE * page_cnt);
+#endif
+
+  old_level = intr_disable ();
+  l = loan_of (pages);
+  if (l != NULL)
+    {
+      /* Borrowed pages go back to their chunk, and the chunk to
+         its lender if either side can do without it. */
+      page_idx = pg_no (pages) - pg_no (l->base);
+      ASSERT (bitmap_all (l->used_map, page_idx, page_cnt));
+      bitmap_set_multiple (l->used_map, page_idx, page_cnt, false);
+      l->free_cnt += page_cnt;
+      if (l->free_cnt == LOAN_PAGES
+          && (l->borrower->free_cnt >= RETURN_HIGH_WATER
+              || l->lender->free_cnt < LEND_LOW_WATER))
+        end_loan (l);
+      intr_set_level (old_level);
+      return;
+    }
+
   if (page_from_pool (&kernel_pool, pages))
     pool = &kernel_pool;
   else if (page_from_pool (&user_pool, pages))
@@ -133,12 +576,10 @@ palloc_free_multiple (void *pages, size_t page_cnt)
 
   page_idx = pg_no (pages) - pg_no (pool->base);
 
-#ifndef NDEBUG
-  memset (pages, 0xcc, PGSIZE * page_cnt);
-#endif
-
   ASSERT (bitmap_all (pool->used_map, page_idx, page_cnt));
   bitmap_set_multiple (pool->used_map, page_idx, page_cnt, false);
+  pool->free_cnt += page_cnt;
+  intr_set_level (old_level);
 }
 
 /* Frees the page at PAGE. */
@@ -148,15 +589,28 @@ palloc_free_page (void *page)
   palloc_free_multiple (page, 1);
 }
 
+/* Prints page allocator statistics. */
+void
+palloc_print_stats (void)
+{
+  printf ("Palloc: kernel pool %lld zeroed hits, %lld misses; "
+          "user pool %lld zeroed hits, %lld misses\n",
+          kernel_pool.zero_hits, kernel_pool.zero_misses,
+          user_pool.zero_hits, user_pool.zero_misses);
+  printf ("Palloc: %lld chunks lent to kernel pool, %lld to user pool\n",
+          kernel_pool.loans_taken, user_pool.loans_taken);
+}
+
 /* Initializes pool P as starting at START and ending at END,
    naming it NAME for debugging purposes. */
 static void
 init_pool (struct pool *p, void *base, size_t page_cnt, const char *name) 
 {
-  /* We'll put the pool's used_map at its base.
-     Calculate the space needed for the bitmap
+  /* We'll put the pool's used_map and zero_map at its base.
+     Calculate the space needed for the bitmaps
      and subtract it from the pool's size. */
-  size_t bm_pages = DIV_ROUND_UP (bitmap_buf_size (page_cnt), PGSIZE);
+  size_t bm_size = bitmap_buf_size (page_cnt);
+  size_t bm_pages = DIV_ROUND_UP (bm_size * 2, PGSIZE);
   if (bm_pages > page_cnt)
     PANIC ("Not enough memory in %s for bitmap.", name);
   page_cnt -= bm_pages;
@@ -165,10 +619,99 @@ init_pool (struct pool *p, void *base, size_t page_cnt, const char *name)
 
   /* Initialize the pool. */
   lock_init (&p->lock);
-  p->used_map = bitmap_create_in_buf (page_cnt, base, bm_pages * PGSIZE);
+  p->used_map = bitmap_create_in_buf (page_cnt, base, bm_size);
+  p->zero_map = bitmap_create_in_buf (page_cnt, (uint8_t *) base + bm_size,
+                                      bm_pages * PGSIZE - bm_size);
+  p->zero_cnt = 0;
+  p->free_cnt = page_cnt;
+  p->zero_hits = p->zero_misses = 0;
+  p->loans_taken = 0;
   p->base = base + bm_pages * PGSIZE;
 }
 
+/* Asks the zeroing thread to refill the pools' stock of zeroed
+   pages. */
+static void
+wake_zero_thread (void)
+{
+  enum intr_level old_level;
+
+  if (!zero_thread_started)
+    return;
+
+  old_level = intr_disable ();
+  if (!zero_wakeup_pending)
+    {
+      zero_wakeup_pending = true;
+      sema_up (&zero_sema);
+    }
+  intr_set_level (old_level);
+}
+
+/* Zeroes one free page of POOL that is not zeroed yet.  The page
+   is marked used while we clear it, so nobody else can take it
+   half-done.  Returns false if POOL has enough zeroed pages or no
+   page left to zero. */
+static bool
+zero_one_page (struct pool *pool)
+{
+  size_t page_idx = 0;
+  void *page;
+
+  lock_acquire (&pool->lock);
+  if (pool->zero_cnt >= ZERO_HIGH_WATER)
+    {
+      lock_release (&pool->lock);
+      return false;
+    }
+  for (;;)
+    {
+      page_idx = bitmap_scan (pool->used_map, page_idx, 1, false);
+      if (page_idx == BITMAP_ERROR || !bitmap_test (pool->zero_map, page_idx))
+        break;
+      page_idx++;
+    }
+  if (page_idx == BITMAP_ERROR)
+    {
+      lock_release (&pool->lock);
+      return false;
+    }
+  bitmap_mark (pool->used_map, page_idx);
+  lock_release (&pool->lock);
+
+  page = pool->base + PGSIZE * page_idx;
+  memset (page, 0, PGSIZE);
+
+  lock_acquire (&pool->lock);
+  bitmap_mark (pool->zero_map, page_idx);
+  bitmap_reset (pool->used_map, page_idx);
+  pool->zero_cnt++;
+  lock_release (&pool->lock);
+  return true;
+}
+
+/* Background thread that keeps both pools stocked with zeroed
+   pages.  Runs at PRI_MIN, so it only gets the CPU when nothing
+   else wants it. */
+static void
+zero_thread (void *aux UNUSED)
+{
+  if (thread_mlfqs)
+    thread_set_nice (20);
+  for (;;)
+    {
+      enum intr_level old_level;
+
+      sema_down (&zero_sema);
+      old_level = intr_disable ();
+      zero_wakeup_pending = false;
+      intr_set_level (old_level);
+
+      while (zero_one_page (&kernel_pool) | zero_one_page (&user_pool))
+        continue;
+    }
+}
+
 /* Returns true if PAGE was allocated from POOL,
    false otherwise. */
 static bool
@@ -1,6 +1,7 @@
 #ifndef THREADS_PALLOC_H
 #define THREADS_PALLOC_H
 
+#include <stdbool.h>
 #include <stddef.h>
 
 /* How to allocate pages. */
@@ -8,13 +9,24 @@ enum palloc_flags
   {
     PAL_ASSERT = 001,           /* Panic on failure. */
     PAL_ZERO = 002,             /* Zero page contents. */
-    PAL_USER = 004              /* User page. */
+    PAL_USER = 004,             /* User page. */
+    PAL_HIGH = 010              /* Highest free page (single pages only). */
   };
 
+/* Called when a multi-page allocation fails, to make room by
+   moving pages around. */
+typedef void palloc_compact_func (void);
+
 void palloc_init (size_t user_page_limit);
 void *palloc_get_page (enum palloc_flags);
 void *palloc_get_multiple (enum palloc_flags, size_t page_cnt);
 void palloc_free_page (void *);
 void palloc_free_multiple (void *, size_t page_cnt);
+size_t palloc_free_cnt (enum palloc_flags);
+void *palloc_range (size_t *page_cnt, size_t *user_idx);
+bool palloc_fragmented (enum palloc_flags, size_t page_cnt);
+void palloc_set_compact_hook (palloc_compact_func *);
+void palloc_start_zero_thread (void);
+void palloc_print_stats (void);
 
 #endif /* threads/palloc.h */
@@ -18,6 +18,7 @@
 #include "devices/timer.h"
 #include <hash.h>
 #include "vm/page.h"
+#include "vm/frame.h"
 
 /* Random value for struct thread's `magic' member.
    Used to detect stack overflow.  See the big comment at the top
@@ -355,6 +356,7 @@ thread_create (const char *name, int priority,
   struct thread *current_thread = thread_current();
   t->recent_cpu = current_thread->recent_cpu;
   t->nice = current_thread->nice;
+  t->rss_limit = current_thread->rss_limit;
 
   // supplementary page table (can't do in init_thread because it is called before malloc is initialized)
   init_sup_page_table(t);
@@ -681,6 +683,7 @@ init_thread (struct thread *t, const char *name, int priority)
 
   // init mmap list
   list_init(&t->mmap_list);
+  list_init(&t->vma_list);
 
   // Initializes file descriptor table to 0
   for(int i=0; i<128; i++){
@@ -693,6 +696,13 @@ init_thread (struct thread *t, const char *name, int priority)
   t->recent_cpu = 0;
 
   t->mid = 0;
+  t->ra_next = NULL;
+  t->ra_window = 0;
+  memset(&t->vmstat, 0, sizeof t->vmstat);
+  t->rss = 0;
+  t->rss_limit = rss_default_limit;
+  t->rss_hand = 0;
+  t->vm_suspended = false;
 
 
   old_level = intr_disable ();
@@ -5,6 +5,7 @@
 #include <list.h>
 #include <stdint.h>
 #include <hash.h>
+#include <vmstat.h>
 #include "threads/synch.h"
 
 
@@ -120,7 +121,16 @@ struct thread
 
     struct hash sup_page_table; /* Supplementary page table */
     struct list mmap_list;
+    struct list vma_list;   /* File-backed ranges, see vm/page.h. */
     int mid;
+    void *ra_next;   /* Page a sequential file fault would hit next. */
+    int ra_window;   /* Pages read along with a file fault. */
+    struct vmstat vmstat;   /* Paging counters, see vm/vmstat.h. */
+    size_t rss;             /* Frames charged to this process. */
+    size_t rss_limit;       /* Most frames it may hold, 0 for no limit. */
+    size_t rss_hand;        /* Clock hand over its own frames. */
+    bool vm_suspended;      /* Stopped by load control, see vm/frame.c. */
+    int64_t vm_suspend_tick; /* When it was stopped. */
 #endif
 
     /* Owned by thread.c. */
@@ -13,6 +13,7 @@
 #include "vm/page.h"
 #include "vm/frame.h"
 #include "vm/swap.h"
+#include "vm/vmstat.h"
 
 /* Number of page faults processed. */
 static long long page_fault_cnt;
@@ -173,6 +174,11 @@ page_fault (struct intr_frame *f)
   write = (f->error_code & PF_W) != 0;
   user = (f->error_code & PF_U) != 0;
 
+  // load control may have stopped this process to end thrashing
+  if(user)
+    frame_table_throttle();
+  uint64_t start = vmstat_fault_begin();
+
   
   struct thread *t = thread_current();
   struct sup_page *sp = sup_page_find_with_vaddr(fault_addr);
@@ -189,6 +195,8 @@ page_fault (struct intr_frame *f)
        is_valid_stack_addr &&
        fault_addr >= PHYS_BASE-MAX_STACK){
       sup_page_table_stack_growth(fault_addr);
+      VMSTAT_INC(t, stack_growths);
+      vmstat_fault_end(t, false, start);
       return;
     }
     else{
@@ -197,7 +205,25 @@ page_fault (struct intr_frame *f)
     }
   }
   
-  load_sup_page(sp);
+  if(!not_present){
+    // write to a present read-only page: copy on write, if the
+    // page may be written at all
+    if(write && frame_table_cow_fault(sp)){
+      vmstat_fault_end(t, false, start);
+      return;
+    }
+    actual_exit(-1);
+  }
+
+  // reading an untouched stack or bss page: map the zero page and
+  // leave the frame for the first write
+  if(!write && frame_table_map_zero(sp)){
+    vmstat_fault_end(t, false, start);
+    return;
+  }
+
+  bool major = load_sup_page(sp);
+  vmstat_fault_end(t, major, start);
   
   return;
 
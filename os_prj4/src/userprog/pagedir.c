@@ -118,6 +118,46 @@ pagedir_set_page (uint32_t *pd, void *upage, void *kpage, bool writable)
     return false;
 }
 
+/* Points the present mapping for user virtual page UPAGE in PD
+   at the physical frame identified by kernel virtual address
+   KPAGE instead, keeping the writable, accessed and dirty bits.
+   Used to migrate a page to another frame; the caller copies the
+   contents. */
+void
+pagedir_replace_page (uint32_t *pd, void *upage, void *kpage)
+{
+  uint32_t *pte;
+
+  ASSERT (pg_ofs (upage) == 0);
+  ASSERT (pg_ofs (kpage) == 0);
+  ASSERT (is_user_vaddr (upage));
+  ASSERT (vtop (kpage) >> PTSHIFT < init_ram_pages);
+
+  pte = lookup_page (pd, upage, false);
+  ASSERT (pte != NULL && (*pte & PTE_P) != 0);
+  *pte = vtop (kpage) | (*pte & PTE_FLAGS);
+  invalidate_pagedir (pd);
+}
+
+/* Sets the writable bit of the present mapping for user virtual
+   page UPAGE in PD to WRITABLE.  Used for copy-on-write. */
+void
+pagedir_set_writable (uint32_t *pd, void *upage, bool writable)
+{
+  uint32_t *pte;
+
+  ASSERT (pg_ofs (upage) == 0);
+  ASSERT (is_user_vaddr (upage));
+
+  pte = lookup_page (pd, upage, false);
+  ASSERT (pte != NULL && (*pte & PTE_P) != 0);
+  if (writable)
+    *pte |= PTE_W;
+  else
+    *pte &= ~(uint32_t) PTE_W;
+  invalidate_pagedir (pd);
+}
+
 /* Looks up the physical address that corresponds to user virtual
    address UADDR in PD.  Returns the kernel virtual address
    corresponding to that physical address, or a null pointer if
@@ -20,8 +20,13 @@
 #include "threads/malloc.h"
 #include "vm/frame.h"
 #include "vm/page.h"
+#include "vm/swap.h"
+#include "vm/vmstat.h"
 
 static thread_func start_process NO_RETURN;
+static thread_func start_fork NO_RETURN;
+static bool fork_files (struct thread *parent, struct thread *child);
+static bool fork_address_space (struct thread *parent, struct thread *child);
 static bool load (const char *cmdline, void (**eip) (void), void **esp);
 
 /* Starts a new thread running a user program loaded from
@@ -83,6 +88,210 @@ start_process (void *file_name_)
   NOT_REACHED ();
 }
 
+/* What a forked child needs from its parent.  Lives on the
+   parent's stack; the parent waits on the child's load_done
+   until the child is done with it. */
+struct fork_args
+  {
+    struct thread *parent;
+    struct intr_frame *if_;             /* Parent's user context. */
+  };
+
+/* Starts a new process that is a copy of the current one, resuming
+   from the user context IF_ with 0 as the system call's return
+   value.  Returns the new process's thread id, or TID_ERROR if
+   the thread cannot be created.  As with process_execute(), the
+   caller learns whether the copy worked through the child's
+   load_done and load_success. */
+tid_t
+process_fork (struct intr_frame *if_)
+{
+  struct thread *cur = thread_current ();
+  struct fork_args args;
+
+  args.parent = cur;
+  args.if_ = if_;
+  return thread_create (cur->name, PRI_DEFAULT, start_fork, &args);
+}
+
+/* A thread function that copies the parent's process and starts
+   it running. */
+static void
+start_fork (void *args_)
+{
+  struct fork_args *args = args_;
+  struct thread *cur = thread_current ();
+  struct intr_frame if_;
+  bool success;
+
+  memcpy (&if_, args->if_, sizeof if_);
+  if_.eax = 0;
+
+  success = (fork_files (args->parent, cur)
+             && fork_address_space (args->parent, cur));
+  if (success)
+    process_activate ();
+
+  /* ARGS is gone once the parent wakes up. */
+  cur->thread_item.load_success = success;
+  sema_up (&cur->thread_item.load_done);
+  if (!success)
+    {
+      sema_down (&cur->thread_item.can_free_resources);
+      thread_exit ();
+    }
+
+  asm volatile ("movl %0, %%esp; jmp intr_exit" : : "g" (&if_) : "memory");
+  NOT_REACHED ();
+}
+
+/* Gives CHILD its own handles on PARENT's executable, open files
+   and mapped files, at the same positions.  (Pintos files cannot
+   share a position, so reads and writes after the fork move the
+   two separately.) */
+static bool
+fork_files (struct thread *parent, struct thread *child)
+{
+  struct list_elem *e;
+  bool success = true;
+  int i;
+
+  lock_acquire (&file_lock);
+  if (parent->exec_file != NULL)
+    {
+      child->exec_file = file_reopen (parent->exec_file);
+      if (child->exec_file == NULL)
+        success = false;
+      else
+        file_deny_write (child->exec_file);
+    }
+
+  for (i = 2; success && i < 128; i++)
+    if (parent->fd_table[i] != NULL)
+      {
+        child->fd_table[i] = file_reopen (parent->fd_table[i]);
+        if (child->fd_table[i] == NULL)
+          success = false;
+        else
+          file_seek (child->fd_table[i], file_tell (parent->fd_table[i]));
+      }
+
+  for (e = list_begin (&parent->mmap_list);
+       success && e != list_end (&parent->mmap_list); e = list_next (e))
+    {
+      struct mmap_file *mf = list_entry (e, struct mmap_file, elem);
+      struct mmap_file *cmf = malloc (sizeof *cmf);
+      if (cmf == NULL)
+        {
+          success = false;
+          break;
+        }
+      cmf->file = file_reopen (mf->file);
+      if (cmf->file == NULL)
+        {
+          free (cmf);
+          success = false;
+          break;
+        }
+      cmf->start_addr = mf->start_addr;
+      cmf->len = mf->len;
+      cmf->mid = mf->mid;
+      list_push_back (&child->mmap_list, &cmf->elem);
+    }
+  child->mid = parent->mid;
+  lock_release (&file_lock);
+
+  return success;
+}
+
+/* Returns CHILD's handle on the file mapped as MID. */
+static struct file *
+child_mmap_file (struct thread *child, int mid)
+{
+  struct list_elem *e;
+
+  for (e = list_begin (&child->mmap_list); e != list_end (&child->mmap_list);
+       e = list_next (e))
+    {
+      struct mmap_file *mf = list_entry (e, struct mmap_file, elem);
+      if (mf->mid == mid)
+        return mf->file;
+    }
+  NOT_REACHED ();
+}
+
+/* Gives CHILD a page directory and supplementary page table that
+   are copies of PARENT's.  Resident pages are shared copy-on-write
+   (see frame_table_fork_page()), swapped-out pages share their swap
+   slot, and everything else is loaded lazily as usual.  Must run
+   after fork_files(). */
+static bool
+fork_address_space (struct thread *parent, struct thread *child)
+{
+  struct hash_iterator i;
+  struct list_elem *e;
+  bool success = true;
+
+  child->pagedir = pagedir_create ();
+  if (child->pagedir == NULL)
+    return false;
+
+  /* Pages not touched yet are only described by the vmas. */
+  for (e = list_begin (&parent->vma_list); e != list_end (&parent->vma_list);
+       e = list_next (e))
+    {
+      struct vma *v = list_entry (e, struct vma, elem);
+      struct vma *cv = malloc (sizeof *cv);
+      if (cv == NULL)
+        return false;
+
+      *cv = *v;
+      if (v->file == parent->exec_file)
+        cv->file = child->exec_file;
+      else if (v->type == PG_MMAP)
+        cv->file = child_mmap_file (child, v->mid);
+      list_push_back (&child->vma_list, &cv->elem);
+    }
+
+  lock_acquire (&frame_lock);
+  hash_first (&i, &parent->sup_page_table);
+  while (success && hash_next (&i))
+    {
+      struct sup_page *sp = hash_entry (hash_cur (&i), struct sup_page, elem);
+      struct sup_page *csp;
+
+      /* Copy the page only once it is fully in or fully out. */
+      frame_table_settle (sp);
+      csp = malloc (sizeof *csp);
+      if (csp == NULL)
+        {
+          success = false;
+          break;
+        }
+
+      memcpy (csp, sp, sizeof *csp);
+      csp->pd = child->pagedir;
+      csp->owner = child;
+      csp->faddr = NULL;
+      csp->zero_mapped = false;
+      csp->pinned = false;
+      if (sp->file != NULL && sp->file == parent->exec_file)
+        csp->file = child->exec_file;
+      else if (sp->type == PG_MMAP
+               || (sp->type == PG_SWAP && sp->prev_type == PG_MMAP))
+        csp->file = child_mmap_file (child, sp->mid);
+
+      if (sp->faddr != NULL)
+        success = frame_table_fork_page (sp, csp);
+      if (sp->type == PG_SWAP || sp->swap_cached)
+        swap_dup_slot (sp->swap_num);
+      hash_insert (&child->sup_page_table, &csp->elem);
+    }
+  lock_release (&frame_lock);
+
+  return success;
+}
+
 struct list_item_thread *can_wait_tid(tid_t tid_to_check, struct thread *t){
     
     for(struct list_elem *e = list_begin(&(t->child_process_list));
@@ -137,13 +346,6 @@ process_wait (tid_t child_tid UNUSED)
   return exit_status;
 }
 
-unsigned sup_destroy (const struct hash_elem *e, void *aux){
-  lock_acquire(&frame_lock);
-  struct sup_page *sp = hash_entry(e, struct sup_page, elem);
-  free(sp);
-  lock_release(&frame_lock);
-}
-
 /* Free the current process's resources. */
 void
 process_exit (void)
@@ -163,14 +365,25 @@ process_exit (void)
   }
   lock_release(&file_lock);
 
-
+  // implicit munmap of everything still mapped
+  while(!list_empty(&cur->mmap_list)){
+    struct mmap_file *mf = list_entry(list_front(&cur->mmap_list),
+                                      struct mmap_file, elem);
+    sup_page_table_remove_mmap(mf);
+  }
 
   /* Destroy the current process's page directory and switch back
      to the kernel-only page directory. */
   pd = cur->pagedir;
-  
 
-  
+  if (vmstat_enabled && pd != NULL)
+    vmstat_print (cur->name, &cur->vmstat);
+
+  /* Load control may have suspended us on the way out; it must not
+     look at this thread once it is gone. */
+  lock_acquire (&frame_lock);
+  cur->vm_suspended = false;
+  lock_release (&frame_lock);
 
   if (pd != NULL) 
     {
@@ -183,7 +396,7 @@ process_exit (void)
          that's been freed (and cleared). */
       cur->pagedir = NULL;
       pagedir_activate (NULL);
-      hash_destroy(&cur->sup_page_table, sup_destroy);
+      destroy_sup_page_table(cur);
       pagedir_destroy (pd);
     }
 }
@@ -539,23 +752,10 @@ load_segment (struct file *file, off_t ofs, uint8_t *upage,
   ASSERT (pg_ofs (upage) == 0);
   ASSERT (ofs % PGSIZE == 0);
 
-  file_seek (file, ofs);
-  while (read_bytes > 0 || zero_bytes > 0) 
-    {
-      /* Calculate how to fill this page.
-         We will read PAGE_READ_BYTES bytes from FILE
-         and zero the final PAGE_ZERO_BYTES bytes. */
-      size_t page_read_bytes = read_bytes < PGSIZE ? read_bytes : PGSIZE;
-      size_t page_zero_bytes = PGSIZE - page_read_bytes;
-
-      sup_page_table_insert_file(file, ofs, upage, page_read_bytes, page_zero_bytes, writable);
-
-      /* Advance. */
-      read_bytes -= page_read_bytes;
-      zero_bytes -= page_zero_bytes;
-      upage += PGSIZE;
-      ofs += page_read_bytes;
-    }
+  /* One vma for the whole segment; its pages are set up as they
+     are touched. */
+  sup_page_table_insert_file (file, ofs, upage, read_bytes, zero_bytes,
+                              writable);
   return true;
 }
 
@@ -575,13 +775,25 @@ setup_stack (void **esp)
   sp->vaddr = ((uint8_t *) PHYS_BASE) - PGSIZE;
   sp->writable = true;
   sp->faddr = NULL;
+  sp->zero_mapped = false;
+  sp->swap_cached = false;
+  sp->pd = t->pagedir;
+  sp->owner = t;
+  sp->pinned = false;
   hash_insert(&t->sup_page_table, &sp->elem);
-  lock_init(&sp->page_lock);
 
 
-  struct frame *f = frame_table_get_frame(sp->vaddr);
+  lock_acquire(&frame_lock);
+  struct frame *f = frame_table_get_frame(sp);
   bool success = install_page(sp->vaddr, f->addr, true);
-  return true;
+  if(success){
+    sp->faddr = f->addr;
+    f->pins = 0;
+  }
+  else
+    frame_table_free_frame(f);
+  lock_release(&frame_lock);
+  return success;
 }
 
 /* Adds a mapping from user virtual address UPAGE to kernel
@@ -12,11 +12,19 @@
 #include "filesys/filesys.h"
 #include "vm/page.h"
 #include "vm/frame.h"
+#include "vm/vmstat.h"
 #include "threads/malloc.h"
+#include "threads/palloc.h"
+#include <string.h>
 
 static void syscall_handler (struct intr_frame *);
 void sys_munmap(struct thread *t, struct intr_frame *f);
 void sys_mmap(struct thread *t, struct intr_frame *f);
+void sys_mmap_flags(struct thread *t, struct intr_frame *f);
+void sys_msync(struct thread *t, struct intr_frame *f);
+void sys_vmstat(struct thread *t, struct intr_frame *f);
+void sys_rss_limit(struct thread *t, struct intr_frame *f);
+void sys_madvise(struct thread *t, struct intr_frame *f);
 
 
 
@@ -56,6 +64,9 @@ syscall_handler (struct intr_frame *f UNUSED)
     case SYS_MAX_OF_FOUR_INT:
       sys_max_of_four_int(t, f);
       break;
+    case SYS_FORK:
+      sys_fork(t, f);
+      break;
     /* File Related */
     case SYS_CREATE:
       sys_create(t, f);
@@ -92,6 +103,21 @@ syscall_handler (struct intr_frame *f UNUSED)
     case SYS_MUNMAP:
       sys_munmap(t, f);
       break;
+    case SYS_MMAP_FLAGS:
+      sys_mmap_flags(t, f);
+      break;
+    case SYS_MSYNC:
+      sys_msync(t, f);
+      break;
+    case SYS_VMSTAT:
+      sys_vmstat(t, f);
+      break;
+    case SYS_RSS_LIMIT:
+      sys_rss_limit(t, f);
+      break;
+    case SYS_MADVISE:
+      sys_madvise(t, f);
+      break;
   }
 }
 
@@ -122,6 +148,41 @@ void read_stack_pointer(uint32_t *pd, void *esp, void **dest){
     check_valid_pointer(pd, *dest);
 }
 
+// copies the user string ustr into a new kernel page, so file
+// system code run under file_lock never faults on it. ustr is pinned
+// a page at a time up to its NUL, and cut short at PGSIZE - 1 bytes.
+// exits if the string runs into an unmapped page. returns NULL if
+// there is no memory for the copy; free it with palloc_free_page()
+static char *copy_in_string(const char *ustr){
+    char *kstr = palloc_get_page(0);
+    if(kstr == NULL){
+        return NULL;
+    }
+
+    size_t len = 0;
+    while(len < PGSIZE - 1){
+        const char *src = ustr + len;
+        size_t chunk = PGSIZE - pg_ofs(src);
+        if(chunk > PGSIZE - 1 - len){
+            chunk = PGSIZE - 1 - len;
+        }
+        if(!pin_user_range(src, chunk, false)){
+            palloc_free_page(kstr);
+            actual_exit(-1);
+        }
+        size_t n = strnlen(src, chunk);
+        memcpy(kstr + len, src, n);
+        unpin_user_range(src, chunk);
+
+        len += n;
+        if(n < chunk){
+            break;
+        }
+    }
+    kstr[len] = '\0';
+    return kstr;
+}
+
 
 void sys_halt(){
     shutdown_power_off();
@@ -161,11 +222,44 @@ struct thread *find_child_thread(tid_t tid){
 
 }
 void sys_exec(struct thread *t, struct intr_frame *f){
-    char *file;
-    read_stack_pointer(t->pagedir, f->esp+4, (void**)&file);
-    
+    char *ufile;
+    read_stack_pointer(t->pagedir, f->esp+4, (void**)&ufile);
+
+    char *file = copy_in_string(ufile);
+    if(file == NULL){
+        f->eax = -1;
+        return;
+    }
     tid_t tid = process_execute(file);
-    
+    palloc_free_page(file);
+    if(tid == TID_ERROR){
+        f->eax = -1;
+        return;
+    }
+
+    struct thread *child_t = find_child_thread(tid);
+
+    sema_down(&child_t->thread_item.load_done);
+
+    if(!child_t->thread_item.load_success){
+        f->eax = -1;
+        list_remove(&child_t->thread_item.elem);
+        sema_up(&child_t->thread_item.can_free_resources);
+    }
+    else{
+        f->eax = tid;
+    }
+}
+
+// child gets a copy-on-write copy of our address space,
+// open files and mmaps, and returns 0 from the system call
+void sys_fork(struct thread *t UNUSED, struct intr_frame *f){
+    tid_t tid = process_fork(f);
+    if(tid == TID_ERROR){
+        f->eax = -1;
+        return;
+    }
+
     struct thread *child_t = find_child_thread(tid);
 
     sema_down(&child_t->thread_item.load_done);
@@ -187,29 +281,10 @@ void sys_wait(struct thread *t, struct intr_frame *f){
 }
 
 
-void set_not_evict(struct frame *f, bool b){
-  f->not_evict = b;
-}
-bool check_buffer_in_pagedir(uint32_t *pd, void* uaddr, bool can_write, bool ne){
-  lock_acquire(&frame_lock);
-  struct sup_page *sp = sup_page_find_with_vaddr(uaddr);
-  if(sp == NULL) return false;
-  if(sp->writable == false && can_write == true) return false;
+// read and write pin at most this much of the user buffer at once,
+// so one large buffer cannot pin down every frame
+#define PIN_CHUNK (16 * PGSIZE)
 
-  struct frame *f;
-  lock_release(&frame_lock);
-  while((f = frame_table_find_with_addr(sp->faddr)) == NULL) {
-    load_sup_page(sp);
-  }
-  lock_acquire(&frame_lock);
-  f->not_evict = ne;
-  lock_release(&frame_lock);
-  if(pagedir_get_page(pd, uaddr) == NULL){
-    load_sup_page(sp);
-  }
-
-  return true;
-}
 void sys_write(struct thread *t, struct intr_frame *f){
     int fd;
     char *buffer;
@@ -219,42 +294,38 @@ void sys_write(struct thread *t, struct intr_frame *f){
     read_stack_pointer(t->pagedir, f->esp+8, (void**)&buffer);
     read_stack_uint32(t->pagedir, f->esp+12, &size);
   
-    int i=0;
-    while(PGSIZE * i < size){
-      if(!check_buffer_in_pagedir(t->pagedir, buffer+PGSIZE*i, false, true)){
+    if(!user_range_mapped(buffer, size, false)){
         actual_exit(-2);
-      }
-      i++;
     }
-
-    if(fd == 1){
-        putbuf(buffer, size);
-        f->eax = size; 
-        return;
-    }
-    else if(fd == 0 || fd > 128 || fd < 0){
-        f->eax = -1;
-        return;
-    }
-
-    // fd not 0, 1
-    struct file *cur_file = t->fd_table[fd];
-    if(cur_file == NULL){
+    if(fd != 1 && (fd == 0 || fd > 128 || fd < 0 || t->fd_table[fd] == NULL)){
         f->eax = -1;
         return;
     }
 
-    lock_acquire(&file_lock);
-    f->eax = file_write(cur_file, buffer, size);
-    lock_release(&file_lock);
+    // each piece stays in memory while it is written
+    unsigned done = 0;
+    while(done < size){
+        unsigned chunk = size - done < PIN_CHUNK ? size - done : PIN_CHUNK;
+        int written = chunk;
+        if(!pin_user_range(buffer + done, chunk, false)){
+            actual_exit(-2);
+        }
+        if(fd == 1){
+            putbuf(buffer + done, chunk);
+        }
+        else{
+            lock_acquire(&file_lock);
+            written = file_write(t->fd_table[fd], buffer + done, chunk);
+            lock_release(&file_lock);
+        }
+        unpin_user_range(buffer + done, chunk);
 
-    i=0;
-    while(PGSIZE * i < size){
-      if(!check_buffer_in_pagedir(t->pagedir, buffer+PGSIZE*i, false, false)){
-        actual_exit(-2);
-      }
-      i++;
+        done += written;
+        if((unsigned) written < chunk){
+            break;
+        }
     }
+    f->eax = done;
 }
 
 void sys_read(struct thread *t, struct intr_frame *f){
@@ -265,48 +336,41 @@ void sys_read(struct thread *t, struct intr_frame *f){
     read_stack_pointer(t->pagedir, f->esp+8, (void**)&buffer);
     read_stack_uint32(t->pagedir, f->esp+12, &size);
     
-    int i=0;
-    while((unsigned)PGSIZE * i < size){
-      if(!check_buffer_in_pagedir(t->pagedir, buffer+PGSIZE*i, true, true)){
+    if(!user_range_mapped(buffer, size, true)){
         actual_exit(-1);
-      }
-      i++;
-    }
-
-    if(fd == 0){
-        for(unsigned i=0; i<size; i++){
-            char c = input_getc();
-            buffer[i] = c;
-        }
-        f->eax = size;
-        lock_release(&file_lock);
-        return;
-    }
-    else if (fd == 1 || fd > 128 || fd < 0){
-        f->eax = -1;
-        lock_release(&file_lock);
-        return;
     }
-
-    // fd not 0, 1
-    struct file *cur_file = t->fd_table[fd];
-    if(cur_file == NULL){
+    if(fd != 0 && (fd == 1 || fd > 128 || fd < 0 || t->fd_table[fd] == NULL)){
         f->eax = -1;
         return;
     }
 
-    
-    lock_acquire(&file_lock);
-    f->eax = file_read(cur_file, buffer, size);
-    lock_release(&file_lock);
+    // each piece stays in memory while it is read into
+    unsigned done = 0;
+    while(done < size){
+        unsigned chunk = size - done < PIN_CHUNK ? size - done : PIN_CHUNK;
+        int got = chunk;
+        if(!pin_user_range(buffer + done, chunk, true)){
+            actual_exit(-1);
+        }
+        if(fd == 0){
+            for(unsigned i=0; i<chunk; i++){
+                char c = input_getc();
+                buffer[done + i] = c;
+            }
+        }
+        else{
+            lock_acquire(&file_lock);
+            got = file_read(t->fd_table[fd], buffer + done, chunk);
+            lock_release(&file_lock);
+        }
+        unpin_user_range(buffer + done, chunk);
 
-    i=0;
-    while((unsigned)PGSIZE * i < size){
-      if(!check_buffer_in_pagedir(t->pagedir, buffer+PGSIZE*i, true, false)){
-        actual_exit(-1);
-      }
-      i++;
+        done += got;
+        if((unsigned) got < chunk){
+            break;
+        }
     }
+    f->eax = done;
 }
 
 void sys_fibonacci(struct thread *t, struct intr_frame *f){
@@ -356,32 +420,50 @@ void sys_max_of_four_int(struct thread *t, struct intr_frame *f){
 }
 
 void sys_create(struct thread *t, struct intr_frame *f){
-    char *file;
+    char *ufile;
     unsigned initial_size;
-    read_stack_pointer(t->pagedir, f->esp+4, (void**)&file);
+    read_stack_pointer(t->pagedir, f->esp+4, (void**)&ufile);
     read_stack_uint32(t->pagedir, f->esp+8, &initial_size);
 
+    char *file = copy_in_string(ufile);
+    if(file == NULL){
+        f->eax = false;
+        return;
+    }
     lock_acquire(&file_lock);
     f->eax = filesys_create(file, initial_size);
     lock_release(&file_lock);
+    palloc_free_page(file);
 }
 
 void sys_remove(struct thread *t, struct intr_frame *f){
-    char *file;
-    read_stack_pointer(t->pagedir, f->esp+4, (void**)&file);
-    
+    char *ufile;
+    read_stack_pointer(t->pagedir, f->esp+4, (void**)&ufile);
+
+    char *file = copy_in_string(ufile);
+    if(file == NULL){
+        f->eax = false;
+        return;
+    }
     lock_acquire(&file_lock);
     f->eax = filesys_remove(file);
     lock_release(&file_lock);
+    palloc_free_page(file);
 }
 
 void sys_open(struct thread *t, struct intr_frame *f){
-    char *file;
-    read_stack_pointer(t->pagedir, f->esp+4, (void**)&file);
+    char *ufile;
+    read_stack_pointer(t->pagedir, f->esp+4, (void**)&ufile);
 
+    char *file = copy_in_string(ufile);
+    if(file == NULL){
+        f->eax = -1;
+        return;
+    }
     lock_acquire(&file_lock);
     struct file *opened_file = filesys_open(file);
     lock_release(&file_lock);
+    palloc_free_page(file);
 
     if(opened_file == NULL){
         f->eax = -1;
@@ -490,22 +572,18 @@ void sys_tell(struct thread *t, struct intr_frame *f){
     lock_release(&file_lock);
 }
 
-void sys_mmap(struct thread *t, struct intr_frame *f){
-  int fd;
-  void *addr;
-  read_stack_int32(t->pagedir, f->esp+4, &fd);
-
-  check_valid_pointer(t->pagedir, f->esp+8);
-  addr = *(void**)(f->esp+8);
-
+// maps the file open as fd at addr, returning the new mapping id
+// or -1. mappings are private to the process: fork() gives the
+// child copy-on-write copies of the pages, not a shared mapping, so
+// after a fork parent and child each write their own copy back to
+// the file on munmap, msync or exit, and the last writer wins
+static int map_file(struct thread *t, int fd, void *addr){
   if(fd > 128 || fd <= 1 || t->fd_table[fd] == NULL){
-    f->eax = -1;
-    return;
+    return -1;
   }
 
   if(pg_ofs(addr) != 0 || addr == 0){
-    f->eax = -1;
-    return;
+    return -1;
   }
 
   // lazy load file of fd, map to addr
@@ -514,23 +592,18 @@ void sys_mmap(struct thread *t, struct intr_frame *f){
   lock_acquire(&file_lock);
   struct file *file = file_reopen(cur_file);
   if (file == NULL){
-    f->eax = -1; // open failed
-    return;
+    lock_release(&file_lock);
+    return -1; // open failed
   }
   
   off_t flen = file_length(file);
   lock_release(&file_lock);
   if (flen == 0){
-    f->eax = -1;
-    return;
+    return -1;
   }
   
-  for(int ofs = 0; ofs < flen; ofs += PGSIZE){
-    void *cur_addr = addr + ofs;
-    if(sup_page_find_with_vaddr(cur_addr) != NULL){
-      f->eax = -1;
-      return;
-    }
+  if(!is_user_vaddr(addr + flen - 1) || !sup_page_range_free(addr, flen)){
+    return -1;
   }
 
 
@@ -542,66 +615,127 @@ void sys_mmap(struct thread *t, struct intr_frame *f){
 
   list_push_front(&t->mmap_list, &mf->elem);
 
-  off_t ofs = 0;
-  while(flen > 0){
-    if(flen < PGSIZE){
-      sup_page_table_insert_mmap(file, ofs, addr, flen, PGSIZE-flen, true, t->mid);
-    }
-    else{
-      sup_page_table_insert_mmap(file, ofs, addr, PGSIZE, 0, true, t->mid);
-    }
-    flen -= PGSIZE;
-    ofs += PGSIZE;
-    addr += PGSIZE;
-  }
+  sup_page_table_insert_mmap(file, addr, flen, true, t->mid);
 
-  f->eax = t->mid++;
+  return t->mid++;
+}
+
+void sys_mmap(struct thread *t, struct intr_frame *f){
+  int fd;
+  void *addr;
+  read_stack_int32(t->pagedir, f->esp+4, &fd);
 
+  check_valid_pointer(t->pagedir, f->esp+8);
+  addr = *(void**)(f->esp+8);
+
+  f->eax = map_file(t, fd, addr);
+}
+
+// mmap with flags. MAP_POPULATE reads the whole file in right away
+// instead of a page at a time as it is touched
+void sys_mmap_flags(struct thread *t, struct intr_frame *f){
+  int fd, flags;
+  void *addr;
+  read_stack_int32(t->pagedir, f->esp+4, &fd);
+
+  check_valid_pointer(t->pagedir, f->esp+8);
+  addr = *(void**)(f->esp+8);
+  read_stack_int32(t->pagedir, f->esp+12, &flags);
+
+  int mid = map_file(t, fd, addr);
+  if(mid != -1 && (flags & MAP_POPULATE)){
+    struct mmap_file *mf = list_entry(list_front(&t->mmap_list),
+                                      struct mmap_file, elem);
+    sup_page_populate(mf->start_addr, mf->len);
+  }
+  f->eax = mid;
 }
 
 void sys_munmap(struct thread *t, struct intr_frame *f){
   int mid;
   read_stack_int32(t->pagedir, f->esp+4, &mid);
   
-  // loop through sup_page_table to find page with mid.
-  // free the page.
-
-  struct list_elem *target;
-
+  // find mmap with mid, write back and free its pages.
   for(struct list_elem *e = list_begin(&t->mmap_list);
       e != list_end(&t->mmap_list);
       e = list_next(e)){
     struct mmap_file *cur = list_entry (e, struct mmap_file, elem);
     if(cur->mid != mid) continue;
 
-    int page_count = cur->len / PGSIZE;
-    void *addr = cur->start_addr;
-
-    for(int i=0; i<page_count; i++){
-      struct sup_page *sp = sup_page_find_with_vaddr(addr);
-      if(pagedir_is_dirty(t->pagedir, sp->vaddr)){
-        lock_acquire(&file_lock);
-        file_write_at(sp->file, sp->vaddr, sp->page_read_bytes, sp->ofs);
-        lock_release(&file_lock);
-      }
+    sup_page_table_remove_mmap(cur);
+    return;
+  }
+}
 
-      pagedir_clear_page(t->pagedir, sp->vaddr);
-      free(sp);
+// writes the modified pages of a mapping back to its file
+void sys_msync(struct thread *t, struct intr_frame *f){
+  int mid;
+  read_stack_int32(t->pagedir, f->esp+4, &mid);
 
-      addr += PGSIZE;
-    }
+  for(struct list_elem *e = list_begin(&t->mmap_list);
+      e != list_end(&t->mmap_list);
+      e = list_next(e)){
+    struct mmap_file *cur = list_entry (e, struct mmap_file, elem);
+    if(cur->mid != mid) continue;
 
-    target = e;
+    sup_page_table_sync_mmap(cur);
+    f->eax = 0;
+    return;
+  }
+  f->eax = -1;
+}
 
-    lock_acquire(&file_lock);
-    file_close(cur->file);
-    lock_release(&file_lock);
+// copies the paging statistics of the caller, or of the whole
+// system, to a user buffer
+void sys_vmstat(struct thread *t, struct intr_frame *f){
+  int which;
+  struct vmstat *st;
+  read_stack_int32(t->pagedir, f->esp+4, &which);
+  read_stack_pointer(t->pagedir, f->esp+8, (void**)&st);
 
+  if(which != VMSTAT_SELF && which != VMSTAT_GLOBAL){
+    f->eax = false;
+    return;
   }
-
-  struct mmap_file *target_mmap = list_entry (target, struct mmap_file, elem);
-  list_remove(target);
-  free(target_mmap);
+  if(!pin_user_range(st, sizeof *st, true))
+    actual_exit(-1);
+  *st = which == VMSTAT_SELF ? t->vmstat : vmstat_global;
+  unpin_user_range(st, sizeof *st);
+  f->eax = true;
 }
 
+// sets the resident-set limit of the caller, inherited by processes
+// it starts from now on. 0 removes the limit, a negative count only
+// reads it. returns the previous limit
+void sys_rss_limit(struct thread *t, struct intr_frame *f){
+  int pages;
+  read_stack_int32(t->pagedir, f->esp+4, &pages);
+
+  lock_acquire(&frame_lock);
+  f->eax = t->rss_limit;
+  if(pages >= 0)
+    t->rss_limit = pages;
+  lock_release(&frame_lock);
+}
 
+// tells the VM how [addr, addr + len) will be used, see
+// sup_page_madvise(). returns 0, or -1 for a bad range or advice
+void sys_madvise(struct thread *t, struct intr_frame *f){
+  unsigned uaddr, len;
+  int advice;
+  // addr is only a range start, not something we dereference, so a
+  // bad one fails the call like a bad len instead of killing us
+  read_stack_uint32(t->pagedir, f->esp+4, &uaddr);
+  read_stack_uint32(t->pagedir, f->esp+8, &len);
+  void *addr = (void *) uaddr;
+  read_stack_int32(t->pagedir, f->esp+12, &advice);
+
+  if(pg_ofs(addr) != 0 || len == 0 || !is_user_vaddr(addr)
+     || (uintptr_t) PHYS_BASE - (uintptr_t) addr < len
+     || advice < MADV_NORMAL || advice > MADV_DONTNEED){
+    f->eax = -1;
+    return;
+  }
+  sup_page_madvise(addr, len, advice);
+  f->eax = 0;
+}
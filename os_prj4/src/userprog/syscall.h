@@ -12,6 +12,7 @@ void sys_halt(void);
 void sys_exit(struct thread *t, struct intr_frame *f);
 void sys_exec(struct thread *t, struct intr_frame *f);
 void sys_wait(struct thread *t, struct intr_frame *f);
+void sys_fork(struct thread *t, struct intr_frame *f);
 void sys_write(struct thread *t, struct intr_frame *f);
 void sys_read(struct thread *t, struct intr_frame *f);
 void sys_create(struct thread *t, struct intr_frame *f);
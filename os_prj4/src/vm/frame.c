@@ -1,187 +1,1219 @@
 #include <hash.h>
+#include <round.h>
 #include "vm/frame.h"
 #include "vm/page.h"
 #include "vm/swap.h"
+#include "vm/vmstat.h"
 #include "threads/malloc.h"
 #include "threads/palloc.h"
 #include "threads/thread.h"
 #include "threads/synch.h"
 #include "threads/vaddr.h"
+#include "threads/interrupt.h"
+#include "devices/timer.h"
 #include "userprog/pagedir.h"
 #include <stdio.h>
+#include <string.h>
 
 
 
-void frame_table_evict_frame(void);
-// manages frames for user
-struct hash frame_table;
-struct list lru_list;
-struct list_elem* cur_lru_elem;
+bool frame_table_evict_frame(void);
+// manages frames for user.
+// one descriptor per physical page palloc can hand out, indexed by
+// (kaddr - frames_base) / PGSIZE. the range covers the kernel pool
+// too, because user pages may come from chunks it lends out.
+// frames below user_first have never held a user page, so the clock
+// and every other walk over user frames start there. it begins at
+// the user pool and moves down when a lent chunk gets a user page
+static struct frame *frames;
+static uint8_t *frames_base;
+static size_t frame_cnt;
+static size_t user_first;
+static size_t clock_hand;
+static size_t resident_cnt;
 struct lock frame_lock;
 
-// returns a frame requested by user 
+// frames being read, written back or evicted are in transit: the
+// I/O runs without frame_lock, and anyone who needs such a frame
+// waits on transit_done. transit_cnt counts them
+static struct condition transit_done;
+static size_t transit_cnt;
+
+static struct frame *frame_of(void *kaddr);
+static void frame_set_user(struct frame *f);
+
+// resident-set limits: every frame is charged to the owner of f->sp
+// (so a shared frame to one of its sharers) in thread's rss. a
+// process at its rss_limit gets a new frame only by evicting one of
+// its own, chosen by a clock that only looks at its frames, so it
+// cannot push other processes' working sets out. -rss=PAGES sets
+// the limit of the first process, which children inherit
+size_t rss_default_limit;
+static long long local_evictions;
+static struct frame *local_victim(struct thread *t);
+static void evict(struct frame *victim);
+
+// page replacement policies, chosen with -vmpolicy=NAME.
+// victim() returns an evictable frame, or NULL if every resident
+// frame is pinned. add() and remove() are optional and see frames
+// becoming resident and going away. all are called with frame_lock
+// held. migration carries pstate over to the new frame as is
+struct frame_policy {
+  const char *name;
+  struct frame *(*victim)(void);
+  void (*add)(struct frame *f);
+  void (*remove)(struct frame *f);
+};
+
+static struct frame *clock_victim(void);
+static struct frame *esc_victim(void);
+static struct frame *twoq_victim(void);
+static void twoq_add(struct frame *f);
+static void twoq_remove(struct frame *f);
+
+static const struct frame_policy policies[] = {
+  {"clock", clock_victim, NULL, NULL},
+  {"esc", esc_victim, NULL, NULL},
+  {"2q", twoq_victim, twoq_add, twoq_remove},
+};
+static const struct frame_policy *policy = &policies[0];
+
+// shared frames: a frame mapped by several processes has a
+// frame_share listing the sup_pages of all of them (the reverse map
+// used to unmap the frame everywhere); the number of sharers is its
+// reference count. f->sp, f->pd and f->vaddr of a shared frame are
+// those of one of the sharers. a share exists only while its frame
+// is resident.
+//
+// frames get shared in two ways. read-only PG_FILE pages are looked
+// up in text_cache by (inode, offset, bytes read) before being read
+// from the file, so every process running the same executable maps
+// the same frame; these shares are cached and stay shared down to
+// one sharer. fork() shares every resident page of the parent with
+// the child, mapped read-only in both; a write fault then gives the
+// writer its own copy (copy on write), and a share left with one
+// sharer turns back into a private frame
+struct text_key {
+  struct inode *inode;
+  off_t ofs;
+  size_t read_bytes;
+};
+
+struct frame_share {
+  struct hash_elem elem; // in text_cache, if cached
+  struct text_key key;
+  bool cached;
+  size_t refs; // number of sharers
+  struct frame *frame;
+  struct list sharers; // sup_pages, linked by share_elem
+};
+
+static struct hash text_cache;
+static long long text_shared_maps;
+static long long cow_copies;
+static long long swap_cache_hits, swap_cache_drops;
+
+// flushd writes dirty mmap pages back to their files every
+// FLUSH_INTERVAL ticks, so little unsaved data piles up between
+// msync calls
+#define FLUSH_INTERVAL (5 * TIMER_FREQ)
+static long long mmap_evict_writes, mmap_flush_writes;
+
+// one page of zeroes, mapped read-only wherever a demand-zero page
+// is read before it is written. never a user frame, never evicted
+static void *zero_page;
+static long long zero_maps;
+static long long zero_fills;
+static void frame_unmap(struct frame *f);
+static bool frame_is_dirty(struct frame *f);
+static void evict_page(struct frame *f, struct sup_page *sp, int *slot);
+static bool drop_swap_cache(void);
+static bool drop_swap_slot(struct sup_page *sp);
+static bool frame_is_accessed(struct frame *f);
+static void frame_clear_accessed(struct frame *f);
+static bool demand_zero(const struct sup_page *sp);
+static struct frame *claim_frame(void *phys, struct sup_page *sp);
+
+// compaction: keep a run of COMPACT_RUN free user pages
+// (one palloc loan chunk) whenever there are enough free pages.
+// compactd checks every COMPACT_INTERVAL ticks
+#define COMPACT_RUN 64
+#define COMPACT_INTERVAL TIMER_FREQ
+static long long compact_moves;
+static void compact_frames(void);
+static void compactd(void *aux);
+
+// kswapd: woken when free user frames drop below KSWAPD_LOW_WATER,
+// evicts until KSWAPD_HIGH_WATER are free, so that page faults
+// usually find a free frame without evicting themselves
+#define KSWAPD_LOW_WATER 16
+#define KSWAPD_HIGH_WATER 48
+static struct semaphore kswapd_sema;
+static bool kswapd_awake;
+static long long kswapd_evictions;
+static long long direct_evictions;
+static long long clean_discards;
+static void kswapd(void *aux);
+static void wake_kswapd(void);
+
+// load control: loadd looks at the last LOADCTL_INTERVAL ticks. if
+// there were at least THRASH_FAULTS major faults, and at least half
+// the evictions took pages loaded less than YOUNG_TICKS before, the
+// system is thrashing: the working sets do not fit. loadd then
+// suspends one process, the lowest priority one holding the most
+// frames, and evicts its pages so the others fit. a suspended
+// process blocks at its next fault from user mode, where it holds
+// no locks. once an interval goes by with less than half as many
+// faults, the process suspended longest is resumed. at least one
+// process always keeps running
+#define LOADCTL_INTERVAL (TIMER_FREQ / 2)
+#define THRASH_FAULTS 64
+#define YOUNG_TICKS TIMER_FREQ
+static struct condition loadctl_resumed;
+static size_t interval_evictions, interval_young;
+static long long loadctl_suspends, loadctl_resumes;
+static void loadd(void *aux);
+
+// descriptor of the frame at kernel address kaddr
+static struct frame *frame_of(void *kaddr){
+  size_t idx = ((uint8_t *) kaddr - frames_base) / PGSIZE;
+  ASSERT((uint8_t *) kaddr >= frames_base && idx < frame_cnt);
+  return &frames[idx];
+}
+
+// returns a frame requested by user
 struct frame* frame_table_get_frame(struct sup_page *sp){
-  struct thread *t = thread_current();
+  // stack and bss pages must start out zeroed; take a pre-zeroed
+  // page if possible
+  enum palloc_flags flags = PAL_USER;
+  if(demand_zero(sp))
+    flags |= PAL_ZERO;
 
-  void *phys = palloc_get_page(PAL_USER);
-  // failed to get page from user pool
-  // currently, just assert
+  // over its limit, a process pays for the frame with one of its own
+  struct thread *t = sp->owner;
+  if(t->rss_limit > 0 && t->rss >= t->rss_limit){
+    struct frame *victim = local_victim(t);
+    if(victim != NULL){
+      evict(victim);
+      local_evictions++;
+    }
+  }
+
+  void *phys = palloc_get_page(flags);
+  // failed to get page from user pool.
+  // palloc borrows from the kernel pool before failing, so at this
+  // point both pools are tight (see palloc_free_cnt) and we must evict.
+  // kswapd normally keeps us from getting here
   while (phys == NULL){
     // find access bit = 0
-    frame_table_evict_frame();
-    phys = palloc_get_page(PAL_USER);
-  }
-  
-  
-  // has to free later
-  struct frame *f = malloc(sizeof(struct frame));
-  f->addr = phys; // allocated by palloc
+    if(frame_table_evict_frame())
+      direct_evictions++;
+    else if(transit_cnt > 0)
+      // everything left is pinned or busy; wait for some I/O
+      cond_wait(&transit_done, &frame_lock);
+    else{
+      // everything left is pinned. pins go away without a signal,
+      // so let their holders run for a tick instead of spinning
+      // with frame_lock held
+      lock_release(&frame_lock);
+      timer_sleep(1);
+      lock_acquire(&frame_lock);
+    }
+    phys = palloc_get_page(flags);
+  }
+  if(palloc_free_cnt(PAL_USER) < KSWAPD_LOW_WATER)
+    wake_kswapd();
+
+  return claim_frame(phys, sp);
+}
+
+// like frame_table_get_frame, but only takes a page that is free
+// anyway: returns NULL instead of evicting, and leaves the last
+// KSWAPD_LOW_WATER free frames alone. for readahead
+struct frame *frame_table_try_get_frame(struct sup_page *sp){
+  if(!frame_table_spare(sp))
+    return NULL;
+  void *phys = palloc_get_page(PAL_USER);
+  if(phys == NULL)
+    return NULL;
+  return claim_frame(phys, sp);
+}
+
+// true if frame_table_try_get_frame(sp) would find a frame
+bool frame_table_spare(struct sup_page *sp){
+  struct thread *t = sp->owner;
+  if(palloc_free_cnt(PAL_USER) <= KSWAPD_LOW_WATER)
+    return false;
+  return t->rss_limit == 0 || t->rss < t->rss_limit;
+}
+
+// fills in the descriptor of user page phys, newly allocated for sp.
+// the frame comes back pinned
+static struct frame *claim_frame(void *phys, struct sup_page *sp){
+  struct thread *t = thread_current();
+  struct frame *f = frame_of(phys);
+  ASSERT(!f->has && !f->in_transit);
   f->pd = t->pagedir;
   f->vaddr = sp->vaddr;
   f->sp = sp;
-  f->not_evict = true;
-  f->has = true;
-  
-  // store frame in frame table
-
-  hash_insert(&frame_table, &f->elem);
-  list_push_back(&lru_list, &f->lru_elem);
-
+  f->pins = 1;
+  frame_set_user(f);
+  f->load_tick = timer_ticks();
+  resident_cnt++;
+  sp->owner->rss++;
+  if(policy->add != NULL)
+    policy->add(f);
 
   return f;
 }
 
 
-// deletes frame from hash table
-// frees dynamically allocated things
+// gives the frame back to palloc and clears its descriptor
 void frame_table_free_frame(struct frame *f){
 
+  if(policy->remove != NULL)
+    policy->remove(f);
+  resident_cnt--;
+  if(f->shared != NULL){
+    struct list_elem *e;
+    for(e = list_begin(&f->shared->sharers);
+        e != list_end(&f->shared->sharers); e = list_next(e))
+      list_entry(e, struct sup_page, share_elem)->faddr = NULL;
+    if(f->shared->cached)
+      hash_delete(&text_cache, &f->shared->elem);
+    free(f->shared);
+    f->shared = NULL;
+  }
   f->has = false;
+  f->sp->owner->rss--;
   f->sp->faddr = NULL;
+  f->sp = NULL;
   f->vaddr = NULL;
   palloc_free_page(f->addr);
-  hash_delete(&frame_table, &f->elem);
-  list_remove(&f->lru_elem);
-  free(f);
 
 }
 
-void frame_table_evict_frame(){
+// waits until the frame holding sp, if any, has no I/O in flight.
+// after that sp is either resident and settled or not resident at
+// all. frame_lock must be held
+void frame_table_settle(struct sup_page *sp){
+  while(sp->faddr != NULL && frame_of(sp->faddr)->in_transit)
+    cond_wait(&transit_done, &frame_lock);
+}
 
-  if(cur_lru_elem == NULL){
-    cur_lru_elem = list_begin(&lru_list);
+// lets go of frame_lock for I/O on f. f is not evicted or moved,
+// and everyone else who wants it waits in frame_table_settle(),
+// until frame_table_io_end(). returns what to pass to that
+bool frame_table_io_begin(struct frame *f){
+  bool outer = !f->in_transit;
+  if(outer){
+    f->in_transit = true;
+    transit_cnt++;
   }
+  lock_release(&frame_lock);
+  return outer;
+}
 
-  struct frame *victim_frame;
-  while(true){
-    struct frame *f = list_entry(cur_lru_elem, struct frame, lru_elem);
-    if(f->not_evict){
-      cur_lru_elem = list_next(cur_lru_elem);
-      if(cur_lru_elem == list_end(&lru_list)){
-        cur_lru_elem = list_begin(&lru_list);
-      }
-      continue;
+// takes frame_lock back after I/O on f
+void frame_table_io_end(struct frame *f, bool outer){
+  lock_acquire(&frame_lock);
+  if(outer){
+    f->in_transit = false;
+    transit_cnt--;
+    cond_broadcast(&transit_done, &frame_lock);
+  }
+}
+
+// unmaps sp from frame f, which it maps, and frees f unless other
+// processes still share it. frame_lock must be held
+void frame_table_release(struct frame *f, struct sup_page *sp){
+  if(f->shared == NULL){
+    pagedir_clear_page(f->pd, f->vaddr);
+    frame_table_free_frame(f);
+    return;
+  }
+
+  struct frame_share *fs = f->shared;
+  pagedir_clear_page(sp->pd, sp->vaddr);
+  list_remove(&sp->share_elem);
+  fs->refs--;
+  sp->faddr = NULL;
+  if(fs->refs == 0){
+    f->sp = sp;
+    frame_table_free_frame(f);
+    return;
+  }
+
+  struct sup_page *next = list_entry(list_front(&fs->sharers),
+                                     struct sup_page, share_elem);
+  if(f->sp == sp){
+    // the frame's charge moves along with f->sp
+    sp->owner->rss--;
+    next->owner->rss++;
+    f->sp = next;
+    f->pd = next->pd;
+    f->vaddr = next->vaddr;
+  }
+  // last holder of a copy-on-write page owns it again; its mapping
+  // is made writable on its next write fault
+  if(fs->refs == 1 && !fs->cached){
+    free(fs);
+    f->shared = NULL;
+  }
+}
+
+// creates a share for the private frame f. returns false if out of
+// memory
+static bool frame_share(struct frame *f, bool cached){
+  struct frame_share *fs = malloc(sizeof *fs);
+  if(fs == NULL)
+    return false;
+  fs->cached = cached;
+  fs->refs = 1;
+  fs->frame = f;
+  list_init(&fs->sharers);
+  list_push_back(&fs->sharers, &f->sp->share_elem);
+  f->shared = fs;
+  return true;
+}
+
+// maps the resident page of parent's sp into the child at child_sp,
+// sharing the frame, for fork(). writable pages become read-only in
+// both processes until one of them writes. returns false if out of
+// memory. frame_lock must be held
+bool frame_table_fork_page(struct sup_page *sp, struct sup_page *child_sp){
+  struct frame *f = frame_table_find_with_addr(sp->faddr);
+  ASSERT(f != NULL);
+
+  if(f->shared == NULL && !frame_share(f, false))
+    return false;
+  if(!pagedir_set_page(child_sp->pd, child_sp->vaddr, f->addr, false)){
+    if(f->shared->refs == 1 && !f->shared->cached){
+      free(f->shared);
+      f->shared = NULL;
     }
-    if(pagedir_is_accessed(f->pd, f->vaddr)){
-      pagedir_set_accessed(f->pd, f->vaddr, false); 
+    return false;
+  }
+  // the child's copy differs from the file exactly when ours does
+  pagedir_set_dirty(child_sp->pd, child_sp->vaddr,
+                    pagedir_is_dirty(sp->pd, sp->vaddr));
+  if(sp->writable)
+    pagedir_set_writable(sp->pd, sp->vaddr, false);
+
+  list_push_back(&f->shared->sharers, &child_sp->share_elem);
+  f->shared->refs++;
+  child_sp->faddr = f->addr;
+  return true;
+}
+
+// resolves a write fault on sp, which is present but mapped
+// read-only. if sp is writable, gives it a private copy of a frame
+// shared by fork(), or just makes the mapping writable if nobody
+// shares the frame anymore. returns false if the write is not
+// allowed
+bool frame_table_cow_fault(struct sup_page *sp){
+  if(!sp->writable)
+    return false;
+
+  lock_acquire(&frame_lock);
+  frame_table_settle(sp);
+  if(sp->zero_mapped){
+    // first write to a page that was only read so far
+    struct frame *zf = frame_table_get_frame(sp);
+    pagedir_clear_page(sp->pd, sp->vaddr);
+    pagedir_set_page(sp->pd, sp->vaddr, zf->addr, true);
+    sp->zero_mapped = false;
+    sp->faddr = zf->addr;
+    zf->pins = 0;
+    zero_fills++;
+    lock_release(&frame_lock);
+    return true;
+  }
+
+  struct frame *f = NULL;
+  if(sp->faddr != NULL)
+    f = frame_table_find_with_addr(sp->faddr);
+  if(f == NULL){
+    // evicted in the meantime; the retried access will fault it in
+    lock_release(&frame_lock);
+    return true;
+  }
+  if(f->shared == NULL){
+    pagedir_set_writable(sp->pd, sp->vaddr, true);
+    lock_release(&frame_lock);
+    return true;
+  }
+
+  // keep the original resident while we copy it
+  f->pins++;
+  struct frame *nf = frame_table_get_frame(sp);
+  memcpy(nf->addr, f->addr, PGSIZE);
+  f->pins--;
+
+  frame_table_release(f, sp);
+  pagedir_set_page(sp->pd, sp->vaddr, nf->addr, true);
+  pagedir_set_dirty(sp->pd, sp->vaddr, true);
+  sp->faddr = nf->addr;
+  nf->pins = 0;
+  cow_copies++;
+  lock_release(&frame_lock);
+  return true;
+}
+
+// true if sp was never touched and starts out as all zeroes:
+// a new stack page or a page of bss
+static bool demand_zero(const struct sup_page *sp){
+  return sp->faddr == NULL
+         && (sp->type == PG_STACK
+             || (sp->type == PG_FILE && sp->page_read_bytes == 0));
+}
+
+// resolves a read fault on sp by mapping the shared zero page
+// read-only, so reading untouched stack or bss costs no frame.
+// returns false if sp does not start out zeroed
+bool frame_table_map_zero(struct sup_page *sp){
+  bool success = false;
+
+  lock_acquire(&frame_lock);
+  if(demand_zero(sp) && !sp->zero_mapped
+     && pagedir_set_page(sp->pd, sp->vaddr, zero_page, false)){
+    sp->zero_mapped = true;
+    zero_maps++;
+    success = true;
+  }
+  lock_release(&frame_lock);
+  return success;
+}
+
+// takes the zero page mapping away from sp. frame_lock must be held
+void frame_table_unmap_zero(struct sup_page *sp){
+  if(!sp->zero_mapped)
+    return;
+  pagedir_clear_page(sp->pd, sp->vaddr);
+  sp->zero_mapped = false;
+}
+
+static void text_key_of(const struct sup_page *sp, struct text_key *key){
+  memset(key, 0, sizeof *key);
+  key->inode = file_get_inode(sp->file);
+  key->ofs = sp->ofs;
+  key->read_bytes = sp->page_read_bytes;
+}
+
+static bool text_shareable(const struct sup_page *sp){
+  return sp->type == PG_FILE && !sp->writable;
+}
+
+// returns the resident frame holding the same text page as sp,
+// or NULL. frame_lock must be held
+struct frame *frame_table_find_text(struct sup_page *sp){
+  struct frame_share ts;
+
+  if(!text_shareable(sp))
+    return NULL;
+  text_key_of(sp, &ts.key);
+  struct hash_elem *e = hash_find(&text_cache, &ts.elem);
+  if(e == NULL)
+    return NULL;
+  return hash_entry(e, struct frame_share, elem)->frame;
+}
+
+// enters f, just loaded for f->sp, into the text cache if it holds
+// read-only text. frame_lock must be held
+void frame_table_share_text(struct frame *f){
+  if(f->shared != NULL || !text_shareable(f->sp))
+    return;
+
+  // sharing is an optimization, so go without if out of memory
+  if(!frame_share(f, true))
+    return;
+  text_key_of(f->sp, &f->shared->key);
+  if(hash_insert(&text_cache, &f->shared->elem) != NULL){
+    // another process loaded the same page while we were reading
+    free(f->shared);
+    f->shared = NULL;
+  }
+}
+
+// records that sp now maps the shared frame f. frame_lock must be
+// held
+void frame_table_map_text(struct frame *f, struct sup_page *sp){
+  ASSERT(f->shared != NULL);
+  list_push_back(&f->shared->sharers, &sp->share_elem);
+  f->shared->refs++;
+  sp->faddr = f->addr;
+  text_shared_maps++;
+}
+
+// removes every mapping of f
+static void frame_unmap(struct frame *f){
+  if(f->shared == NULL){
+    pagedir_clear_page(f->pd, f->vaddr);
+    return;
+  }
+  struct list_elem *e;
+  for(e = list_begin(&f->shared->sharers);
+      e != list_end(&f->shared->sharers); e = list_next(e)){
+    struct sup_page *sp = list_entry(e, struct sup_page, share_elem);
+    pagedir_clear_page(sp->pd, sp->vaddr);
+  }
+}
+
+// a shared frame counts as accessed if any sharer used it
+static bool frame_is_accessed(struct frame *f){
+  if(f->shared == NULL)
+    return pagedir_is_accessed(f->pd, f->vaddr);
+  struct list_elem *e;
+  for(e = list_begin(&f->shared->sharers);
+      e != list_end(&f->shared->sharers); e = list_next(e)){
+    struct sup_page *sp = list_entry(e, struct sup_page, share_elem);
+    if(pagedir_is_accessed(sp->pd, sp->vaddr))
+      return true;
+  }
+  return false;
+}
+
+// likewise for the dirty bit
+static bool frame_is_dirty(struct frame *f){
+  if(f->shared == NULL)
+    return pagedir_is_dirty(f->pd, f->vaddr);
+  struct list_elem *e;
+  for(e = list_begin(&f->shared->sharers);
+      e != list_end(&f->shared->sharers); e = list_next(e)){
+    struct sup_page *sp = list_entry(e, struct sup_page, share_elem);
+    if(pagedir_is_dirty(sp->pd, sp->vaddr))
+      return true;
+  }
+  return false;
+}
+
+static void frame_clear_accessed(struct frame *f){
+  if(f->shared == NULL){
+    pagedir_set_accessed(f->pd, f->vaddr, false);
+    return;
+  }
+  struct list_elem *e;
+  for(e = list_begin(&f->shared->sharers);
+      e != list_end(&f->shared->sharers); e = list_next(e)){
+    struct sup_page *sp = list_entry(e, struct sup_page, share_elem);
+    pagedir_set_accessed(sp->pd, sp->vaddr, false);
+  }
+}
+
+// selects the replacement policy by name. called while parsing
+// kernel options, before the frame table is set up
+bool frame_table_set_policy(const char *name){
+  for(size_t i = 0; i < sizeof policies / sizeof *policies; i++)
+    if(!strcmp(policies[i].name, name)){
+      policy = &policies[i];
+      return true;
     }
-    else{
-      pagedir_clear_page(f->pd, f->vaddr);
-      victim_frame = f;
-      cur_lru_elem = list_next(cur_lru_elem);
-      if(cur_lru_elem == list_end(&lru_list)){
-        cur_lru_elem = list_begin(&lru_list);
-      }
-      break;
+  return false;
+}
+
+// marks f as holding a user page, widening the range the clock
+// sweeps if f is in a chunk the kernel pool lent out
+static void frame_set_user(struct frame *f){
+  f->has = true;
+  if((size_t) (f - frames) < user_first)
+    user_first = f - frames;
+}
+
+// number of frames the clock sweeps
+static size_t user_frame_cnt(void){
+  return frame_cnt - user_first;
+}
+
+// returns the frame under the clock hand and advances the hand
+static struct frame *clock_next(void){
+  if(clock_hand < user_first)
+    clock_hand = user_first;
+  struct frame *f = &frames[clock_hand];
+  clock_hand = clock_hand + 1 < frame_cnt ? clock_hand + 1 : user_first;
+  return f;
+}
+
+static bool evictable(struct frame *f){
+  return f->has && f->pins == 0 && !f->in_transit;
+}
+
+// plain clock (second chance): the first frame found with its
+// accessed bit clear, clearing the bits passed over
+static struct frame *clock_victim(void){
+  // two full turns of the clock clear every accessed bit, so if
+  // nothing turned up by then everything is pinned (or free)
+  for(size_t budget = 2 * user_frame_cnt() + 1; budget > 0; budget--){
+    struct frame *f = clock_next();
+    if(!evictable(f))
+      continue;
+    if(!frame_is_accessed(f))
+      return f;
+    frame_clear_accessed(f);
+  }
+  return NULL;
+}
+
+// enhanced second chance: prefers (not accessed, clean) over
+// (not accessed, dirty), so eviction writes less. turn 1 looks for
+// the first kind without touching anything, turn 2 for the second
+// kind while clearing accessed bits; turns 3 and 4 repeat that
+// and must succeed unless everything is pinned
+static struct frame *esc_victim(void){
+  for(int turn = 0; turn < 4; turn++){
+    bool want_dirty = turn % 2 == 1;
+    for(size_t n = user_frame_cnt(); n > 0; n--){
+      struct frame *f = clock_next();
+      if(!evictable(f))
+        continue;
+      bool accessed = frame_is_accessed(f);
+      if(!accessed && frame_is_dirty(f) == want_dirty)
+        return f;
+      if(accessed && want_dirty)
+        frame_clear_accessed(f);
     }
+  }
+  return NULL;
+}
+
+// 2Q, approximated with accessed bits and a single clock.
+// a new page goes on probation: the first time the hand reaches it
+// its accessed bit (set by the access that faulted it in) is
+// cleared and it turns cold. a cold page that is still not
+// accessed at the next pass is evicted; one that was used again
+// is promoted to hot. hot pages are demoted to cold when the hand
+// finds them unused. so a page touched only once, like one from a
+// big sequential scan, leaves after two passes, while the working
+// set stays hot. at most 3/4 of resident frames may be hot, so
+// there are always cold pages to take. no ghost list is kept
+enum { TWOQ_NEW, TWOQ_COLD, TWOQ_HOT };
+static size_t twoq_hot_cnt;
+
+static void twoq_add(struct frame *f){
+  f->pstate = TWOQ_NEW;
+}
+
+static void twoq_remove(struct frame *f){
+  if(f->pstate == TWOQ_HOT)
+    twoq_hot_cnt--;
+}
+
+static struct frame *twoq_victim(void){
+  // a page is at worst new -> cold -> evicted, or hot -> cold ->
+  // evicted, so three turns are enough unless everything is pinned
+  for(size_t budget = 3 * user_frame_cnt() + 1; budget > 0; budget--){
+    struct frame *f = clock_next();
+    if(!evictable(f))
+      continue;
+    bool accessed = frame_is_accessed(f);
+    if(accessed)
+      frame_clear_accessed(f);
 
-    cur_lru_elem = list_next(cur_lru_elem);
-    if(cur_lru_elem == list_end(&lru_list)){
-      cur_lru_elem = list_begin(&lru_list);
+    switch(f->pstate){
+      case TWOQ_NEW:
+        f->pstate = TWOQ_COLD;
+        if(!accessed)
+          return f;
+        break;
+      case TWOQ_COLD:
+        if(!accessed)
+          return f;
+        if(twoq_hot_cnt < resident_cnt * 3 / 4){
+          f->pstate = TWOQ_HOT;
+          twoq_hot_cnt++;
+        }
+        break;
+      case TWOQ_HOT:
+        if(!accessed){
+          f->pstate = TWOQ_COLD;
+          twoq_hot_cnt--;
+        }
+        break;
     }
   }
-  
+  return NULL;
+}
+
+// second chance over the frames charged to t, with t's own hand.
+// returns NULL if they are all pinned. frame_lock must be held
+static struct frame *local_victim(struct thread *t){
+  for(size_t budget = 2 * user_frame_cnt() + 1; budget > 0; budget--){
+    if(t->rss_hand < user_first)
+      t->rss_hand = user_first;
+    struct frame *f = &frames[t->rss_hand];
+    t->rss_hand = t->rss_hand + 1 < frame_cnt ? t->rss_hand + 1 : user_first;
+    if(!evictable(f) || f->sp->owner != t)
+      continue;
+    if(!frame_is_accessed(f))
+      return f;
+    frame_clear_accessed(f);
+  }
+  return NULL;
+}
+
+// evicts one frame chosen by the replacement policy.
+// returns false if every frame is pinned. frame_lock must be held
+bool frame_table_evict_frame(){
+  struct frame *victim_frame = policy->victim();
+  if(victim_frame == NULL)
+    return false;
+  evict(victim_frame);
+  return true;
+}
+
+// writes victim_frame out as needed and frees it
+static void evict(struct frame *victim_frame){
+  interval_evictions++;
+  if(timer_elapsed(victim_frame->load_tick) < YOUNG_TICKS)
+    interval_young++;
+
+  // writes to swap or the file let go of frame_lock; keep everyone
+  // off the frame until it is gone
+  victim_frame->in_transit = true;
+  transit_cnt++;
+  frame_unmap(victim_frame);
+
   // got victim frame
-  // determine vaddr type, write to disk if needed
+  // determine vaddr type of every page in it, write to disk if needed.
+  // pages of a shared frame that need swap all get the same slot
   struct frame *f = victim_frame;
+  int slot = -1;
+  if(f->shared == NULL)
+    evict_page(f, f->sp, &slot);
+  else{
+    struct list_elem *e;
+    for(e = list_begin(&f->shared->sharers);
+        e != list_end(&f->shared->sharers); e = list_next(e))
+      evict_page(f, list_entry(e, struct sup_page, share_elem), &slot);
+  }
 
+  f->in_transit = false;
+  transit_cnt--;
+  frame_table_free_frame(f);
+  cond_broadcast(&transit_done, &frame_lock);
+}
+
+// records that sp's page is leaving frame f, writing the frame to
+// swap slot *slot first if sp needs it there. *slot is -1 until the
+// frame has been written, after that sharers just take a reference
+static void evict_page(struct frame *f, struct sup_page *sp, int *slot){
+  bool dirty = pagedir_is_dirty(sp->pd, sp->vaddr);
+
+  // VMSTAT_EVICT_* are numbered like the resident page types
+  if(sp->type != PG_SWAP)
+    VMSTAT_INC(sp->owner, evictions[sp->type]);
+
+  // back from swap and not written since: the slot still has it
+  if(sp->swap_cached){
+    sp->swap_cached = false;
+    if(!dirty){
+      sp->prev_type = sp->type;
+      sp->type = PG_SWAP;
+      sp->faddr = NULL;
+      swap_cache_hits++;
+      return;
+    }
+    swap_free_slot(sp->swap_num);
+  }
 
-  struct sup_page *sp = f->sp;
   switch(sp->type){
     case PG_MMAP:
-      if(pagedir_is_dirty(f->pd, sp->vaddr)){
-        // write dirty file to swap
-        sp->prev_type = sp->type;
-        sp->type = PG_SWAP;
-        sp->swap_num = swap_save_into_swap(f->addr);
-        sp->faddr = NULL;
+      // dirty pages go back to their file, after which they are
+      // clean and can be dropped. swap is only for when this thread
+      // already holds file_lock
+      if(!lock_held_by_current_thread(&file_lock)){
+        if(sup_page_writeback(sp))
+          mmap_evict_writes++;
+        return;
       }
-
       // not dirty -> just free
-
+      if(!dirty)
+        return;
       break;
 
-    case PG_FILE: case PG_STACK:
-      sp->prev_type = sp->type;
-      sp->type = PG_SWAP;
-      sp->swap_num = swap_save_into_swap(f->addr);
-      sp->faddr = NULL;
+    case PG_FILE:
+      // clean executable pages (read-only text, or data never
+      // written) are still in the file; drop them and read them
+      // again on the next fault
+      if(!sp->writable || !dirty){
+        clean_discards++;
+        return;
+      }
+      break;
+    case PG_STACK:
       break;
     case PG_SWAP:
+      return;
+  }
+
+  if(*slot == -1){
+    bool outer = frame_table_io_begin(f);
+    *slot = swap_save_into_swap(f->addr, sp->pd);
+    // swap is full: the slots still held for resident clean pages
+    // are only a shortcut, give them up and try again
+    while(*slot == -1 && drop_swap_cache())
+      *slot = swap_save_into_swap(f->addr, sp->pd);
+    frame_table_io_end(f, outer);
+    if(*slot == -1)
+      PANIC("out of swap space");
+  }
+  else
+    swap_dup_slot(*slot);
+  VMSTAT_INC(sp->owner, swap_outs);
+  sp->prev_type = sp->type;
+  sp->type = PG_SWAP;
+  sp->swap_num = *slot;
+  sp->faddr = NULL;
+}
+
+// forgets the swap slot of every resident page that still has one,
+// freeing the slots nobody else holds. the page then exists only in
+// its frame, so it is marked dirty: otherwise a writable executable
+// page would be dropped and read back stale from the file on the
+// next eviction, and an mmap page would never be written back.
+// returns false if there was none to drop. called with frame_lock
+// released, from inside an eviction
+static bool drop_swap_cache(void){
+  bool dropped = false;
+
+  lock_acquire(&frame_lock);
+  for(size_t i = user_first; i < frame_cnt; i++){
+    struct frame *f = &frames[i];
+    // frames in transit are being loaded or evicted, and whoever is
+    // doing that owns their swap_cached
+    if(!f->has || f->in_transit)
+      continue;
+    if(f->shared == NULL){
+      dropped |= drop_swap_slot(f->sp);
+      continue;
+    }
+    struct list_elem *e;
+    for(e = list_begin(&f->shared->sharers);
+        e != list_end(&f->shared->sharers); e = list_next(e))
+      dropped |= drop_swap_slot(list_entry(e, struct sup_page, share_elem));
+  }
+  lock_release(&frame_lock);
+  return dropped;
+}
+
+// drop_swap_cache() for one resident page. frame_lock must be held
+static bool drop_swap_slot(struct sup_page *sp){
+  if(!sp->swap_cached)
+    return false;
+  sp->swap_cached = false;
+  pagedir_set_dirty(sp->pd, sp->vaddr, true);
+  swap_free_slot(sp->swap_num);
+  swap_cache_drops++;
+  return true;
+}
+
+static void wake_kswapd(void){
+  enum intr_level old_level = intr_disable();
+  if(!kswapd_awake){
+    kswapd_awake = true;
+    sema_up(&kswapd_sema);
+  }
+  intr_set_level(old_level);
+}
+
+// background page-out thread. frame_lock is taken per eviction so
+// faulting threads can get in between
+static void kswapd(void *aux UNUSED){
+  while(true){
+    sema_down(&kswapd_sema);
+    bool evicted = true;
+    while(palloc_free_cnt(PAL_USER) < KSWAPD_HIGH_WATER){
+      lock_acquire(&frame_lock);
+      evicted = frame_table_evict_frame();
+      lock_release(&frame_lock);
+      if(!evicted)
+        break;
+      kswapd_evictions++;
+    }
+
+    // a wake_kswapd() after the last check above saw us awake and
+    // did nothing, so look again before going to sleep. if
+    // everything is pinned, wait for the next wakeup instead
+    enum intr_level old_level = intr_disable();
+    if(evicted && palloc_free_cnt(PAL_USER) < KSWAPD_LOW_WATER)
+      sema_up(&kswapd_sema);
+    else
+      kswapd_awake = false;
+    intr_set_level(old_level);
+  }
+}
+
+// moves the contents of f to the frame at new_addr and points
+// the owner's page table entry there. frame_lock must be held
+static void frame_table_migrate_frame(struct frame *f, void *new_addr){
+  struct frame *nf = frame_of(new_addr);
+
+  // nobody may touch the page between the copy and the remap
+  enum intr_level old_level = intr_disable();
+  memcpy(new_addr, f->addr, PGSIZE);
+  if(f->shared == NULL)
+    pagedir_replace_page(f->pd, f->vaddr, new_addr);
+  else{
+    struct list_elem *e;
+    for(e = list_begin(&f->shared->sharers);
+        e != list_end(&f->shared->sharers); e = list_next(e)){
+      struct sup_page *sp = list_entry(e, struct sup_page, share_elem);
+      pagedir_replace_page(sp->pd, sp->vaddr, new_addr);
+      sp->faddr = new_addr;
+    }
+  }
+  intr_set_level(old_level);
+
+  ASSERT(!nf->has);
+  nf->pd = f->pd;
+  nf->vaddr = f->vaddr;
+  nf->sp = f->sp;
+  nf->pins = 0;
+  frame_set_user(nf);
+  nf->pstate = f->pstate;
+  nf->load_tick = f->load_tick;
+  nf->shared = f->shared;
+  if(nf->shared != NULL)
+    nf->shared->frame = nf;
+  nf->sp->faddr = new_addr;
+
+  f->shared = NULL;
+
+  f->has = false;
+  f->sp = NULL;
+  f->vaddr = NULL;
+  palloc_free_page(f->addr);
+  compact_moves++;
+}
+
+// moves every movable user frame as high up in the user pool as it
+// will go, so the free pages left behind form contiguous runs at
+// the bottom. frame_lock must be held
+static void compact_frames(void){
+  for(size_t i = user_first; i < frame_cnt; i++){
+    struct frame *f = &frames[i];
+    if(!f->has || f->pins > 0 || f->in_transit)
+      continue;
+
+    void *dst = palloc_get_page(PAL_USER | PAL_HIGH);
+    if(dst == NULL)
+      break;
+    if(dst < f->addr){
+      // this frame and every one after it are already above
+      // every free page
+      palloc_free_page(dst);
       break;
+    }
+    frame_table_migrate_frame(f, dst);
   }
+}
 
+// on-demand compaction, called by palloc when a multi-page
+// allocation fails. gives up if the frame table is busy, since the
+// caller may hold locks that the frame_lock holder is waiting on
+void frame_table_compact(void){
+  if(lock_held_by_current_thread(&frame_lock) ||
+     !lock_try_acquire(&frame_lock))
+    return;
+  compact_frames();
+  lock_release(&frame_lock);
+}
 
-  frame_table_free_frame(f);
+// background compaction thread
+static void compactd(void *aux UNUSED){
+  while(true){
+    timer_sleep(COMPACT_INTERVAL);
+    if(!palloc_fragmented(PAL_USER, COMPACT_RUN))
+      continue;
+    lock_acquire(&frame_lock);
+    compact_frames();
+    lock_release(&frame_lock);
+  }
+}
 
+// background writeback of mmap pages. frame_lock is taken per frame
+// so faulting threads can get in between
+static void flushd(void *aux UNUSED){
+  while(true){
+    timer_sleep(FLUSH_INTERVAL);
+    for(size_t i = user_first; i < frame_cnt; i++){
+      struct frame *f = &frames[i];
+      lock_acquire(&frame_lock);
+      if(!f->has || f->in_transit)
+        ;
+      else if(f->shared == NULL && f->sp->type == PG_MMAP
+         && sup_page_writeback(f->sp))
+        mmap_flush_writes++;
+      else if(f->shared != NULL){
+        struct list_elem *e;
+        for(e = list_begin(&f->shared->sharers);
+            e != list_end(&f->shared->sharers); e = list_next(e)){
+          struct sup_page *sp = list_entry(e, struct sup_page, share_elem);
+          if(sp->type == PG_MMAP && sup_page_writeback(sp))
+            mmap_flush_writes++;
+        }
+      }
+      lock_release(&frame_lock);
+    }
+  }
 }
 
-struct frame *frame_table_find_with_addr(void *addr){
-  struct frame f;
+// blocks the current process while load control has it suspended.
+// call only where it holds no locks
+void frame_table_throttle(void){
   struct thread *t = thread_current();
+  if(!t->vm_suspended)
+    return;
+  lock_acquire(&frame_lock);
+  while(t->vm_suspended)
+    cond_wait(&loadctl_resumed, &frame_lock);
+  lock_release(&frame_lock);
+}
 
-  addr = pg_round_down(addr);
-  f.addr = addr;
+// what loadd learns from one pass over all threads
+struct loadctl_scan {
+  size_t running; // user processes with frames, not suspended
+  struct thread *victim; // lowest priority, most frames
+  struct thread *oldest; // suspended the longest
+};
 
-  struct hash_elem *cur_hash_elem = hash_find(&frame_table, &f.elem);
-  if (cur_hash_elem == NULL)
-    return NULL;
-  struct frame *ff = hash_entry(cur_hash_elem, struct frame, elem);
+// thread_foreach() callback, with interrupts off
+static void loadctl_scan_thread(struct thread *t, void *aux){
+  struct loadctl_scan *scan = aux;
+  if(t->pagedir == NULL)
+    return;
+  if(t->vm_suspended){
+    if(scan->oldest == NULL
+       || t->vm_suspend_tick < scan->oldest->vm_suspend_tick)
+      scan->oldest = t;
+    return;
+  }
+  if(t->rss == 0)
+    return;
+  scan->running++;
+  if(scan->victim == NULL
+     || t->priority < scan->victim->priority
+     || (t->priority == scan->victim->priority
+         && t->rss > scan->victim->rss))
+    scan->victim = t;
+}
 
-  return ff;
+// suspends t and evicts every private frame charged to it.
+// frame_lock must be held
+static void loadctl_suspend(struct thread *t){
+  t->vm_suspended = true;
+  t->vm_suspend_tick = timer_ticks();
+  loadctl_suspends++;
+  // only t is compared against from here on: it may exit while
+  // evict() has frame_lock dropped
+  for(size_t i = user_first; i < frame_cnt; i++){
+    struct frame *f = &frames[i];
+    if(evictable(f) && f->shared == NULL && f->sp->owner == t)
+      evict(f);
+  }
 }
 
+static void loadd(void *aux UNUSED){
+  long long last_faults = 0;
+
+  while(true){
+    timer_sleep(LOADCTL_INTERVAL);
 
+    lock_acquire(&frame_lock);
+    long long faults = vmstat_global.major_faults - last_faults;
+    last_faults = vmstat_global.major_faults;
+    bool thrashing = faults >= THRASH_FAULTS && interval_evictions > 0
+                     && interval_young * 2 >= interval_evictions;
+    interval_evictions = interval_young = 0;
 
+    // frame_lock keeps the threads found here from exiting: they
+    // hold frames, or sleep on loadctl_resumed
+    struct loadctl_scan scan = {0, NULL, NULL};
+    enum intr_level old_level = intr_disable();
+    thread_foreach(loadctl_scan_thread, &scan);
+    intr_set_level(old_level);
 
-// use hash_bytes as hash function. hash 4 bytes (address)
-unsigned simple_hash_func(const struct hash_elem *e, void *aux){
-  const struct frame *f = hash_entry(e, struct frame, elem);
-  return hash_bytes(&f->addr, sizeof(f->addr));
+    if(thrashing && scan.running > 1)
+      loadctl_suspend(scan.victim);
+    else if(!thrashing && faults < THRASH_FAULTS / 2 && scan.oldest != NULL){
+      scan.oldest->vm_suspended = false;
+      loadctl_resumes++;
+      cond_broadcast(&loadctl_resumed, &frame_lock);
+    }
+    lock_release(&frame_lock);
+  }
 }
 
-bool simple_hash_less_func(const struct hash_elem *a,
-							   const struct hash_elem *b,
-							   void *aux){
-  const struct frame *af = hash_entry(a, struct frame, elem);
-  const struct frame *bf = hash_entry(b, struct frame, elem);
-  return af->addr < bf->addr;
+void frame_table_print_stats(void){
+  printf("Frame: %s replacement policy\n", policy->name);
+  printf("Frame: %lld evicted by kswapd, %lld evicted directly\n",
+         kswapd_evictions, direct_evictions);
+  printf("Frame: %lld evicted by processes over their rss limit\n",
+         local_evictions);
+  printf("Frame: %lld processes suspended for thrashing, %lld resumed\n",
+         loadctl_suspends, loadctl_resumes);
+  printf("Frame: %lld clean file pages dropped instead of swapped\n",
+         clean_discards);
+  printf("Frame: %lld text pages mapped from another process\n",
+         text_shared_maps);
+  printf("Frame: %lld pages copied on write\n", cow_copies);
+  printf("Frame: %lld clean pages put back in their swap slot, "
+         "%lld slots given up when swap was full\n",
+         swap_cache_hits, swap_cache_drops);
+  printf("Frame: %lld mmap pages written back on eviction, %lld by flushd\n",
+         mmap_evict_writes, mmap_flush_writes);
+  printf("Frame: %lld zero page maps, %lld later written\n",
+         zero_maps, zero_fills);
+  printf("Frame: %lld frames migrated by compaction\n", compact_moves);
 }
 
-void frame_table_init(){
-  hash_init(&frame_table, simple_hash_func, 
-	  simple_hash_less_func, NULL); 
+// returns the frame holding kernel address addr,
+// or NULL if no user page lives there
+struct frame *frame_table_find_with_addr(void *addr){
+  uint8_t *page = pg_round_down(addr);
+  if(page < frames_base || (size_t) (page - frames_base) / PGSIZE >= frame_cnt)
+    return NULL;
 
-  list_init(&lru_list);
-  lock_init(&frame_lock);
-  cur_lru_elem = NULL;
-  
+  struct frame *f = frame_of(page);
+  if(!f->has)
+    return NULL;
+  return f;
 }
 
 
+static unsigned text_hash_func(const struct hash_elem *e, void *aux UNUSED){
+  const struct frame_share *ts = hash_entry(e, struct frame_share, elem);
+  return hash_bytes(&ts->key, sizeof ts->key);
+}
 
+static bool text_less_func(const struct hash_elem *a,
+                           const struct hash_elem *b, void *aux UNUSED){
+  const struct frame_share *as = hash_entry(a, struct frame_share, elem);
+  const struct frame_share *bs = hash_entry(b, struct frame_share, elem);
+  return memcmp(&as->key, &bs->key, sizeof as->key) < 0;
+}
 
+void frame_table_init(){
+  // one descriptor for every page that can end up as a user frame
+  frames_base = palloc_range(&frame_cnt, &user_first);
+  size_t pages = DIV_ROUND_UP(frame_cnt * sizeof(struct frame), PGSIZE);
+  frames = palloc_get_multiple(PAL_ASSERT | PAL_ZERO, pages);
+  for(size_t i = 0; i < frame_cnt; i++)
+    frames[i].addr = frames_base + i * PGSIZE;
+  clock_hand = user_first;
+  zero_page = palloc_get_page(PAL_ASSERT | PAL_ZERO);
 
+  lock_init(&frame_lock);
+  cond_init(&transit_done);
+  hash_init(&text_cache, text_hash_func, text_less_func, NULL);
+
+  palloc_set_compact_hook(frame_table_compact);
+  thread_create("compactd", PRI_DEFAULT, compactd, NULL);
+  thread_create("flushd", PRI_DEFAULT, flushd, NULL);
 
+  sema_init(&kswapd_sema, 0);
+  thread_create("kswapd", PRI_DEFAULT, kswapd, NULL);
 
+  cond_init(&loadctl_resumed);
+  thread_create("loadd", PRI_DEFAULT, loadd, NULL);
 
+}
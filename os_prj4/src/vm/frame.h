@@ -1,31 +1,50 @@
 #ifndef VM_FRAME_H
 #define VM_FRAME_H
 
-#include <hash.h>
 #include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
 
 
+// one per physical page, see frames[] in frame.c, so every byte
+// here costs a byte per page of RAM: 32 bytes on i386 as laid out
 struct frame {
-  struct hash_elem elem;
-  // addr of frame
+  // addr of frame, fixed for the descriptor
   void *addr;
   void *vaddr; // virtual address the frame is using
   uint32_t *pd;
   struct sup_page *sp;
-  bool not_evict;
-  bool has;
-
-  struct list_elem lru_elem;
-
-  // additional info on frame
-  // for eviction
+  uint16_t pins; // not evicted or moved while nonzero
+  bool has : 1; // true if a user page lives here
+  bool in_transit : 1; // I/O in flight without frame_lock, see io_begin
+  uint8_t pstate; // replacement policy's private state
+  int64_t load_tick; // when the frame was filled, see loadd
+  struct frame_share *shared; // non-null if several processes map it
 };
 
 extern struct lock frame_lock;
+extern size_t rss_default_limit;
 struct frame *frame_table_get_frame(struct sup_page*);
+struct frame *frame_table_try_get_frame(struct sup_page *);
+bool frame_table_spare(struct sup_page *);
 void frame_table_free_frame(struct frame*);
 void frame_table_init(void);
 struct frame *frame_table_find_with_addr(void *addr);
+void frame_table_compact(void);
+void frame_table_print_stats(void);
+bool frame_table_set_policy(const char *name);
+void frame_table_release(struct frame *, struct sup_page *);
+struct frame *frame_table_find_text(struct sup_page *);
+void frame_table_share_text(struct frame *);
+void frame_table_map_text(struct frame *, struct sup_page *);
+bool frame_table_fork_page(struct sup_page *, struct sup_page *child_sp);
+bool frame_table_cow_fault(struct sup_page *);
+bool frame_table_map_zero(struct sup_page *);
+void frame_table_unmap_zero(struct sup_page *);
+void frame_table_settle(struct sup_page *);
+bool frame_table_io_begin(struct frame *);
+void frame_table_throttle(void);
+void frame_table_io_end(struct frame *, bool outer);
 
 
 
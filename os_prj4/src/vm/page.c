@@ -1,12 +1,31 @@
 #include <hash.h>
 #include "vm/page.h"
 #include "vm/frame.h"
+#include "vm/swap.h"
+#include "vm/vmstat.h"
 #include "threads/thread.h"
+#include "threads/palloc.h"
 #include "threads/malloc.h"
 #include "threads/vaddr.h"
 #include "userprog/pagedir.h"
+#include <round.h>
 #include <string.h>
+#include <syscall-nr.h>
 
+// fault-around: a fault on a file or mmap page also reads in up to
+// ra_window pages of the same file that follow it. the window starts
+// at FAULT_AROUND_MIN and doubles up to FAULT_AROUND_MAX while the
+// faults are sequential
+#define FAULT_AROUND_MIN 2
+#define FAULT_AROUND_MAX 16
+
+// madvise(MADV_SEQUENTIAL) reads FAULT_AROUND_MAX pages right away,
+// and the pages more than DROP_BEHIND pages behind a fault are
+// marked not accessed, so they are the first to be evicted
+#define DROP_BEHIND (2 * FAULT_AROUND_MAX)
+
+static struct vma *vma_find(struct thread *t, void *vaddr);
+static struct sup_page *sup_page_lookup(struct thread *t, void *vaddr);
 
 
 
@@ -41,14 +60,226 @@ void init_sup_page_table(struct thread *t){
             sup_hash_less_func, NULL);
 }
 
+// gives back the frame or swap slot held by sp.
+// frame_lock must be held
+static void sup_page_release(struct sup_page *sp){
+  // flushd or an eviction may be writing it out right now
+  frame_table_settle(sp);
+  // the zero page is shared by everyone, pagedir_destroy must not
+  // free it
+  frame_table_unmap_zero(sp);
+  if(sp->swap_cached){
+    swap_free_slot(sp->swap_num);
+    sp->swap_cached = false;
+  }
+  if(sp->faddr != NULL){
+    struct frame *f = frame_table_find_with_addr(sp->faddr);
+    if(f != NULL)
+      frame_table_release(f, sp);
+  }
+  else if(sp->type == PG_SWAP){
+    swap_free_slot(sp->swap_num);
+  }
+}
 
-struct sup_page *sup_page_find_with_vaddr(void *vaddr){
-  struct sup_page sp;
+static void sup_page_destroy(struct hash_elem *e, void *aux UNUSED){
+  struct sup_page *sp = hash_entry(e, struct sup_page, elem);
+
+  lock_acquire(&frame_lock);
+  sup_page_release(sp);
+  lock_release(&frame_lock);
+  free(sp);
+}
+
+// frees every page of t, along with its frames and swap slots,
+// so nothing in the frame table points at a dead process.
+// must run before t's page directory is destroyed
+void destroy_sup_page_table(struct thread *t){
+  hash_destroy(&t->sup_page_table, sup_page_destroy);
+  while(!list_empty(&t->vma_list))
+    free(list_entry(list_pop_front(&t->vma_list), struct vma, elem));
+}
+
+// writes mmap page sp, which is resident, back to its file if it
+// was modified, and marks it clean. returns true if it wrote.
+// frame_lock must be held, file_lock must not
+bool sup_page_writeback(struct sup_page *sp){
+  // a page back from swap differs from the file even if clean
+  if(!pagedir_is_dirty(sp->pd, sp->vaddr) && !sp->swap_cached)
+    return false;
+
+  // clear the bit first: a write that lands during the file write
+  // dirties the page again instead of getting lost
+  pagedir_set_dirty(sp->pd, sp->vaddr, false);
+  if(sp->swap_cached){
+    swap_free_slot(sp->swap_num);
+    sp->swap_cached = false;
+  }
+  struct frame *f = frame_table_find_with_addr(sp->faddr);
+  bool outer = frame_table_io_begin(f);
+  lock_acquire(&file_lock);
+  file_write_at(sp->file, f->addr, sp->page_read_bytes, sp->ofs);
+  lock_release(&file_lock);
+  frame_table_io_end(f, outer);
+  return true;
+}
+
+// writes mmap page sp back to its file if it was modified, whether
+// it is in memory or in swap. frame_lock must be held, and is let
+// go of during the I/O, since file_lock ranks below it
+static void mmap_page_flush(struct sup_page *sp){
+  if(sp->faddr != NULL)
+    sup_page_writeback(sp);
+  else if(sp->type == PG_SWAP){
+    // only dirty mmap pages go to swap. take the slot away from sp
+    // first: with no frame and no slot, nothing else can reach it
+    int slot = sp->swap_num;
+    sp->type = sp->prev_type;
+    lock_release(&frame_lock);
+
+    void *kpage = palloc_get_page(PAL_ASSERT);
+    swap_load_from_swap(slot, kpage);
+    lock_acquire(&file_lock);
+    file_write_at(sp->file, kpage, sp->page_read_bytes, sp->ofs);
+    lock_release(&file_lock);
+    palloc_free_page(kpage);
+
+    lock_acquire(&frame_lock);
+  }
+}
+
+// writes the modified pages of mf back to its file, keeping them
+// mapped
+void sup_page_table_sync_mmap(struct mmap_file *mf){
   struct thread *t = thread_current();
 
-  vaddr = pg_round_down(vaddr);
-  sp.vaddr = vaddr;
+  for(off_t ofs = 0; ofs < mf->len; ofs += PGSIZE){
+    struct sup_page *sp = sup_page_lookup(t, mf->start_addr + ofs);
+    if(sp == NULL) continue;
+
+    lock_acquire(&frame_lock);
+    frame_table_settle(sp);
+    if(sp->faddr != NULL)
+      sup_page_writeback(sp);
+    lock_release(&frame_lock);
+  }
+}
+
+// unmaps mf from current process, writing dirty pages back
+// to the file, and frees mf
+void sup_page_table_remove_mmap(struct mmap_file *mf){
+  struct thread *t = thread_current();
+
+  // only pages that were touched have a sup_page
+  for(off_t ofs = 0; ofs < mf->len; ofs += PGSIZE){
+    struct sup_page *sp = sup_page_lookup(t, mf->start_addr + ofs);
+    if(sp == NULL) continue;
+
+    lock_acquire(&frame_lock);
+    frame_table_settle(sp);
+    mmap_page_flush(sp);
+    sup_page_release(sp);
+    lock_release(&frame_lock);
+
+    hash_delete(&t->sup_page_table, &sp->elem);
+    free(sp);
+  }
+
+  // madvise() may have split the mapping into several vmas
+  struct list_elem *e = list_begin(&t->vma_list);
+  while(e != list_end(&t->vma_list)){
+    struct vma *v = list_entry(e, struct vma, elem);
+    e = list_next(e);
+    if(v->type == PG_MMAP && v->mid == mf->mid){
+      list_remove(&v->elem);
+      free(v);
+    }
+  }
+
+  lock_acquire(&file_lock);
+  file_close(mf->file);
+  lock_release(&file_lock);
 
+  list_remove(&mf->elem);
+  free(mf);
+}
+
+
+// returns the vma of t containing vaddr, or NULL
+static struct vma *vma_find(struct thread *t, void *vaddr){
+  struct list_elem *e;
+
+  for(e = list_begin(&t->vma_list); e != list_end(&t->vma_list);
+      e = list_next(e)){
+    struct vma *v = list_entry(e, struct vma, elem);
+    if(vaddr < v->start)
+      break;
+    if(vaddr < v->end)
+      return v;
+  }
+  return NULL;
+}
+
+// adds a vma to the current process, keeping vma_list sorted
+static void vma_insert(enum page_type type, struct file *file, off_t ofs,
+                       void *start, size_t read_bytes, size_t size,
+                       bool writable, int mid){
+  struct thread *t = thread_current();
+  struct vma *v = malloc(sizeof *v);
+  if(v == NULL)
+    PANIC("no memory for vma");
+  v->type = type;
+  v->file = file;
+  v->ofs = ofs;
+  v->start = start;
+  v->end = start + size;
+  v->read_bytes = read_bytes;
+  v->writable = writable;
+  v->mid = mid;
+  v->advice = MADV_NORMAL;
+
+  struct list_elem *e;
+  for(e = list_begin(&t->vma_list); e != list_end(&t->vma_list);
+      e = list_next(e))
+    if(list_entry(e, struct vma, elem)->start > start)
+      break;
+  list_insert(e, &v->elem);
+}
+
+// creates the sup_page for vaddr, inside v, the first time
+// it is looked up
+static struct sup_page *vma_page(struct thread *t, struct vma *v,
+                                 void *vaddr){
+  size_t page_ofs = vaddr - v->start;
+  struct sup_page *sp = malloc(sizeof(struct sup_page));
+  if(sp == NULL)
+    return NULL;
+  sp->type = v->type;
+  sp->file = v->file;
+  sp->ofs = v->ofs + page_ofs;
+  sp->page_read_bytes = v->read_bytes <= page_ofs ? 0
+                        : v->read_bytes - page_ofs < PGSIZE
+                        ? v->read_bytes - page_ofs : PGSIZE;
+  sp->page_zero_bytes = PGSIZE - sp->page_read_bytes;
+  sp->writable = v->writable;
+  sp->mid = v->mid;
+  sp->pinned = false;
+  sp->faddr = NULL;
+  sp->zero_mapped = false;
+  sp->swap_cached = false;
+  sp->pd = t->pagedir;
+  sp->owner = t;
+
+  sp->vaddr = vaddr;
+  hash_insert(&t->sup_page_table, &sp->elem);
+  return sp;
+}
+
+// returns the sup_page for vaddr if one has been created
+static struct sup_page *sup_page_lookup(struct thread *t, void *vaddr){
+  struct sup_page sp;
+
+  sp.vaddr = pg_round_down(vaddr);
   struct hash_elem *cur_hash_elem = hash_find(&t->sup_page_table, &sp.elem);
   if (cur_hash_elem == NULL)
     return NULL;
@@ -56,6 +287,124 @@ struct sup_page *sup_page_find_with_vaddr(void *vaddr){
   return hash_entry(cur_hash_elem, struct sup_page, elem);
 }
 
+// returns the page at vaddr, creating it from its vma if it has
+// not been touched yet. NULL if vaddr is not mapped
+struct sup_page *sup_page_find_with_vaddr(void *vaddr){
+  struct thread *t = thread_current();
+
+  vaddr = pg_round_down(vaddr);
+  struct sup_page *sp = sup_page_lookup(t, vaddr);
+  if(sp == NULL){
+    struct vma *v = vma_find(t, vaddr);
+    if(v != NULL)
+      sp = vma_page(t, v, vaddr);
+  }
+  return sp;
+}
+
+// true if nothing is mapped in [start, start + size)
+bool sup_page_range_free(void *start, size_t size){
+  struct thread *t = thread_current();
+  struct list_elem *e;
+
+  for(e = list_begin(&t->vma_list); e != list_end(&t->vma_list);
+      e = list_next(e)){
+    struct vma *v = list_entry(e, struct vma, elem);
+    if(v->start < start + size && start < v->end)
+      return false;
+  }
+  // stack pages have no vma
+  for(size_t ofs = 0; ofs < size; ofs += PGSIZE)
+    if(sup_page_lookup(t, start + ofs) != NULL)
+      return false;
+  return true;
+}
+
+// splits the vma of t containing addr, if any, so that a vma
+// starts at addr
+static void vma_split(struct thread *t, void *addr){
+  struct vma *v = vma_find(t, addr);
+  if(v == NULL || v->start == addr)
+    return;
+  struct vma *nv = malloc(sizeof *nv);
+  if(nv == NULL)
+    PANIC("no memory for vma");
+  size_t head = addr - v->start;
+  *nv = *v;
+  nv->start = addr;
+  nv->ofs = v->ofs + head;
+  nv->read_bytes = v->read_bytes > head ? v->read_bytes - head : 0;
+  v->end = addr;
+  v->read_bytes = v->read_bytes < head ? v->read_bytes : head;
+  list_insert(list_next(&v->elem), &nv->elem);
+}
+
+// frees the memory and swap behind sp. file pages are read again
+// on the next touch, so mmap pages are written back first; stack
+// pages come back zeroed
+static void drop_page(struct thread *t, struct sup_page *sp){
+  lock_acquire(&frame_lock);
+  frame_table_settle(sp);
+  enum page_type type = sp->type == PG_SWAP ? sp->prev_type : sp->type;
+  if(type == PG_MMAP)
+    mmap_page_flush(sp);
+  sup_page_release(sp);
+  lock_release(&frame_lock);
+
+  if(type == PG_STACK){
+    // no vma to rebuild it from
+    sp->type = PG_STACK;
+    return;
+  }
+  hash_delete(&t->sup_page_table, &sp->elem);
+  free(sp);
+}
+
+// applies madvise() advice to the pages of [addr, addr + len), which
+// must be page aligned and in user space
+void sup_page_madvise(void *addr, size_t len, int advice){
+  struct thread *t = thread_current();
+  void *end = addr + ROUND_UP(len, PGSIZE);
+
+  switch(advice){
+    case MADV_NORMAL: case MADV_RANDOM: case MADV_SEQUENTIAL:
+      // the advice is kept on the vmas, split to fit the range
+      vma_split(t, addr);
+      vma_split(t, end);
+      for(struct list_elem *e = list_begin(&t->vma_list);
+          e != list_end(&t->vma_list); e = list_next(e)){
+        struct vma *v = list_entry(e, struct vma, elem);
+        if(v->start >= addr && v->end <= end)
+          v->advice = advice;
+      }
+      break;
+
+    case MADV_WILLNEED:
+      // read in what is on disk while there are free frames, the
+      // way readahead does; never evict for it
+      for(void *page = addr; page < end; page += PGSIZE){
+        struct sup_page *sp = sup_page_find_with_vaddr(page);
+        if(sp == NULL || sp->faddr != NULL)
+          continue;
+        if(sp->type != PG_SWAP
+           && (sp->type == PG_STACK || sp->page_read_bytes == 0))
+          continue;
+        if(!frame_table_spare(sp))
+          break;
+        load_sup_page(sp);
+      }
+      break;
+
+    case MADV_DONTNEED:
+      for(void *page = addr; page < end; page += PGSIZE){
+        struct sup_page *sp = sup_page_lookup(t, page);
+        if(sp != NULL)
+          drop_page(t, sp);
+      }
+      break;
+  }
+}
+
 void sup_page_table_stack_growth(void *vaddr){
   struct thread *t = thread_current();
   vaddr = pg_round_down(vaddr);
@@ -67,81 +416,186 @@ void sup_page_table_stack_growth(void *vaddr){
     sp->vaddr = vaddr;
     sp->writable = true;
     sp->faddr = NULL;
+    sp->zero_mapped = false;
+    sp->swap_cached = false;
+    sp->pd = t->pagedir;
+    sp->owner = t;
 
     hash_insert(&t->sup_page_table, &sp->elem);
     vaddr += PGSIZE;
     sp->pinned = false;
-    lock_init(&sp->page_lock);
   }
   // allocation of frame is done later in exception
 }
 
+// maps an ELF segment: read_bytes from file at ofs, then zero_bytes
+// of zeroes. pages are set up when first touched
 void sup_page_table_insert_file(struct file *file, off_t ofs, uint8_t *upage,
-              uint32_t page_read_bytes, uint32_t page_zero_bytes, bool writable){
-  struct thread *t = thread_current();
-  // record information into supplementary page table
-  struct sup_page *sp = malloc(sizeof(struct sup_page));
-  sp->type = PG_FILE;
-  sp->file = file;
-  sp->ofs = ofs;
-  sp->page_read_bytes = page_read_bytes;
-  sp->page_zero_bytes = page_zero_bytes;
-  sp->writable = writable;
-  sp->pinned = false;
-  sp->faddr = NULL;
-  lock_init(&sp->page_lock);
+              uint32_t read_bytes, uint32_t zero_bytes, bool writable){
+  vma_insert(PG_FILE, file, ofs, upage, read_bytes,
+             read_bytes + zero_bytes, writable, 0);
+}
 
-  sp->vaddr = upage;
-  hash_insert(&t->sup_page_table, &sp->elem);
+// maps len bytes of file, from its start, at upage as mapping mid
+void sup_page_table_insert_mmap(struct file *file, uint8_t *upage,
+              off_t len, bool writable, int mid){
+  vma_insert(PG_MMAP, file, 0, upage, len, ROUND_UP(len, PGSIZE),
+             writable, mid);
+}
+
+// true if np, at vaddr, holds the part of sp's file that
+// follows sp and is not in memory yet
+static bool readahead_ok(struct sup_page *sp, struct sup_page *np,
+                         void *vaddr){
+  return np != NULL
+         && np->type == sp->type
+         && np->file == sp->file
+         && np->ofs == sp->ofs + (vaddr - sp->vaddr)
+         && np->page_read_bytes > 0
+         && np->faddr == NULL
+         && !np->zero_mapped
+         && pagedir_get_page(np->pd, vaddr) == NULL;
 }
 
-void sup_page_table_insert_mmap(struct file *file, off_t ofs, uint8_t *upage,
-              uint32_t page_read_bytes, uint32_t page_zero_bytes, bool writable,
-              int mid){
+// a sequential reader is done with the pages well behind vaddr, in
+// v: let the replacement policy take them before anything else.
+// frame_lock must be held
+static void drop_behind(struct thread *t, struct vma *v, void *vaddr){
+  if(vaddr - v->start < (DROP_BEHIND + FAULT_AROUND_MAX) * PGSIZE)
+    return;
+  void *page = vaddr - DROP_BEHIND * PGSIZE;
+  for(int i = 0; i < FAULT_AROUND_MAX; i++){
+    page -= PGSIZE;
+    struct sup_page *sp = sup_page_lookup(t, page);
+    if(sp != NULL && sp->faddr != NULL)
+      pagedir_set_accessed(sp->pd, sp->vaddr, false);
+  }
+}
 
+// picks the pages to read along with a fault on file page sp, and
+// gets a frame for each. pages another process already has in
+// memory are mapped right away. the window grows while faults land
+// just past the previous one. returns the number of pages put in
+// sps and frames, which are still to be read and installed.
+// frame_lock must be held
+static size_t fault_around(struct sup_page *sp, struct sup_page **sps,
+                           struct frame **frames){
   struct thread *t = thread_current();
-  // record information into supplementary page table
-  struct sup_page *sp = malloc(sizeof(struct sup_page));
-  sp->type = PG_MMAP;
-  sp->file = file;
-  sp->ofs = ofs;
-  sp->page_read_bytes = page_read_bytes;
-  sp->page_zero_bytes = page_zero_bytes;
-  sp->writable = writable;
-  sp->mid = mid;
-  sp->pinned = false;
-  sp->faddr = NULL;
-  lock_init(&sp->page_lock);
+  struct vma *v = vma_find(t, sp->vaddr);
+  int advice = v != NULL ? v->advice : MADV_NORMAL;
+  size_t cnt = 0;
+
+  if(advice == MADV_RANDOM)
+    return 0;
+  if(advice == MADV_SEQUENTIAL){
+    t->ra_window = FAULT_AROUND_MAX;
+    drop_behind(t, v, sp->vaddr);
+  }
+  else if(sp->vaddr == t->ra_next)
+    t->ra_window = t->ra_window * 2 < FAULT_AROUND_MAX
+                   ? t->ra_window * 2 : FAULT_AROUND_MAX;
+  else
+    t->ra_window = FAULT_AROUND_MIN;
+
+  void *vaddr = sp->vaddr + PGSIZE;
+  for(int i = 0; i < t->ra_window; i++, vaddr += PGSIZE){
+    struct sup_page *np = sup_page_find_with_vaddr(vaddr);
+    if(!readahead_ok(sp, np, vaddr))
+      break;
 
-  sp->vaddr = upage;
-  hash_insert(&t->sup_page_table, &sp->elem);
+    struct frame *f = frame_table_find_text(np);
+    if(f != NULL){
+      if(!install_page(np->vaddr, f->addr, false))
+        break;
+      frame_table_map_text(f, np);
+      continue;
+    }
+
+    // never evict anything just to read ahead
+    f = frame_table_try_get_frame(np);
+    if(f == NULL)
+      break;
+    sps[cnt] = np;
+    frames[cnt++] = f;
+  }
+  t->ra_next = vaddr;
+
+  return cnt;
+}
+
+// reads the file contents of cnt pages into their frames, taking
+// file_lock once for all of them
+static void read_file_pages(struct sup_page **sps, struct frame **frames,
+                            size_t cnt){
+  lock_acquire(&file_lock);
+  for(size_t i = 0; i < cnt; i++){
+    struct sup_page *sp = sps[i];
+    // bss pages come zeroed from the frame allocator
+    if(sp->page_read_bytes == 0)
+      continue;
+    // a short read means the file ends early (an executable cut
+    // short, say): like mmap past the end, the rest reads as zeroes
+    off_t read = file_read_at(sp->file, frames[i]->addr,
+                              sp->page_read_bytes, sp->ofs);
+    if(read < 0)
+      read = 0;
+    memset(frames[i]->addr + read, 0, PGSIZE - read);
+  }
+  lock_release(&file_lock);
 }
 
-void load_sup_page(struct sup_page *sp){
+// brings sp into memory. returns true if that took a read from
+// its file or swap, false if it was already there or needed none
+bool load_sup_page(struct sup_page *sp){
 
   struct frame *frame;
   bool prev_file_lock = false;
-  struct thread *t = thread_current();
+  bool outer;
+
+  // frame_lock is held throughout, except while the frame is read
+  lock_acquire(&frame_lock);
+  frame_table_settle(sp);
+  if(sp->faddr != NULL){
+    lock_release(&frame_lock);
+    return false;
+  }
+
+  // the page gets a frame of its own now; drop the read-only
+  // zero page mapping so install_page can replace it
+  if(sp->zero_mapped)
+    frame_table_unmap_zero(sp);
 
   // Use supplementary page table to know what kind of page
   switch (sp->type){
     case PG_FILE: case PG_MMAP:
-      lock_acquire(&frame_lock);
-      // get page of memory from frame allocator
-      frame = frame_table_get_frame(sp);
-      
-      lock_acquire(&file_lock);
-      file_seek(sp->file, sp->ofs);
-      // load page
-      if(file_read (sp->file, frame->addr, sp->page_read_bytes)
-          != (int) sp->page_read_bytes){
-            frame_table_free_frame(frame);
-            ASSERT(false); // TODO: think about what to do if load fail
+      // read-only text another process already has in memory:
+      // just map the same frame
+      frame = frame_table_find_text(sp);
+      if(frame != NULL){
+        // out of memory for a page table: nothing is mapped yet,
+        // and exiting tears down the address space under frame_lock
+        if(!install_page(sp->vaddr, frame->addr, false)){
+          lock_release(&frame_lock);
+          actual_exit(-1);
+        }
+        frame_table_map_text(frame, sp);
+        lock_release(&frame_lock);
+        return false;
       }
 
-      memset(frame->addr + sp->page_read_bytes, 0, sp->page_zero_bytes);
-      lock_release(&file_lock);
-      
+      // get page of memory from frame allocator, along with frames
+      // for the pages that follow it, and read them all in one go
+      struct sup_page *batch[FAULT_AROUND_MAX + 1];
+      struct frame *frames[FAULT_AROUND_MAX + 1];
+      batch[0] = sp;
+      frames[0] = frame_table_get_frame(sp);
+      size_t cnt = 1 + fault_around(sp, batch + 1, frames + 1);
+      // the frames are pinned, so the read can go without frame_lock
+      outer = frame_table_io_begin(frames[0]);
+      read_file_pages(batch, frames, cnt);
+      frame_table_io_end(frames[0], outer);
+      frame = frames[0];
+
       // add page to process address space
       if (!install_page (sp->vaddr, frame->addr, sp->writable)){
         printf("file\n");
@@ -149,13 +603,27 @@ void load_sup_page(struct sup_page *sp){
       }
 
       sp->faddr = frame->addr;
-      frame->not_evict = false;
+      frame->pins = 0;
+      frame_table_share_text(frame);
+
+      // the neighbours go in with the accessed bit clear, so the
+      // replacement policy takes them first if they are never used
+      for(size_t i = 1; i < cnt; i++){
+        if(!install_page(batch[i]->vaddr, frames[i]->addr,
+                         batch[i]->writable)){
+          frame_table_free_frame(frames[i]);
+          continue;
+        }
+        batch[i]->faddr = frames[i]->addr;
+        frames[i]->pins = 0;
+        frame_table_share_text(frames[i]);
+      }
       lock_release(&frame_lock);
-      return;
+      // bss pages are zero-filled, not read
+      return sp->page_read_bytes > 0;
     
 
     case PG_STACK:
-      lock_acquire(&frame_lock);
       frame = frame_table_get_frame(sp);
 
       bool success = install_page(sp->vaddr, frame->addr, true);
@@ -165,35 +633,118 @@ void load_sup_page(struct sup_page *sp){
       }
 
       sp->faddr = frame->addr;
-      frame->not_evict = false;
+      frame->pins = 0;
       lock_release(&frame_lock);
-      return;
+      return false;
     
 
     // get frame and write from swap
     case PG_SWAP:
-      lock_acquire(&frame_lock);
       frame = frame_table_get_frame(sp);
-      swap_load_from_swap(sp->swap_num, frame->addr);
+      // keep the slot: if the page is evicted again before it is
+      // written, it can go back there without a write
+      outer = frame_table_io_begin(frame);
+      swap_read_slot(sp->swap_num, frame->addr);
+      frame_table_io_end(frame, outer);
       sp->type = sp->prev_type;
+      sp->swap_cached = true;
+      VMSTAT_INC(sp->owner, swap_ins);
 
       if(!install_page(sp->vaddr, frame->addr, sp->writable)){
         printf("swp\n");
         actual_exit(-1);
       }
       sp->faddr = frame->addr;
-      frame->not_evict = false;
+      frame->pins = 0;
       lock_release(&frame_lock);
-      return;
+      return true;
 
     default:
       break;
   }
-
-  
-
+  lock_release(&frame_lock);
+  return false;
 }
 
+// loads every page of [addr, addr + len) that is not in memory yet
+void sup_page_populate(void *addr, off_t len){
+  for(off_t ofs = 0; ofs < len; ofs += PGSIZE){
+    struct sup_page *sp = sup_page_find_with_vaddr(addr + ofs);
+    if(sp != NULL && sp->faddr == NULL)
+      load_sup_page(sp);
+  }
+}
 
+// true if every page of the user buffer [uaddr, uaddr + len) is
+// mapped, and writable if writable is set. nothing is loaded
+bool user_range_mapped(const void *uaddr, size_t len, bool writable){
+  if(len == 0)
+    return true;
+  void *first = pg_round_down(uaddr);
+  void *last = pg_round_down(uaddr + len - 1);
+  if(last < first || !is_user_vaddr(last))
+    return false;
+
+  for(void *page = first; page <= last; page += PGSIZE){
+    struct sup_page *sp = sup_page_find_with_vaddr(page);
+    if(sp == NULL || (writable && !sp->writable))
+      return false;
+  }
+  return true;
+}
 
+// makes every page of the user buffer [uaddr, uaddr + len) resident
+// and pins it, so system calls can use the buffer without faulting,
+// even while holding file_lock. writable asks for pages the kernel
+// may write. returns false, with nothing pinned, if some page is not
+// mapped or not writable. undo with unpin_user_range().
+// every pinned frame is one eviction cannot take, so callers pin a
+// bounded piece of a large buffer at a time
+bool pin_user_range(const void *uaddr, size_t len, bool writable){
+  if(len == 0)
+    return true;
+  // check the whole range before pinning any of it
+  if(!user_range_mapped(uaddr, len, writable))
+    return false;
+  void *first = pg_round_down(uaddr);
+  void *last = pg_round_down(uaddr + len - 1);
+
+  // writes break copy-on-write sharing now rather than in the fault
+  // handler
+  if(writable)
+    for(void *page = first; page <= last; page += PGSIZE)
+      frame_table_cow_fault(sup_page_find_with_vaddr(page));
+
+  // load_sup_page drops frame_lock for I/O, and a page may be
+  // evicted again before we get it back, so check under the lock
+  lock_acquire(&frame_lock);
+  for(void *page = first; page <= last; page += PGSIZE){
+    struct sup_page *sp = sup_page_lookup(thread_current(), page);
+    frame_table_settle(sp);
+    while(sp->faddr == NULL){
+      lock_release(&frame_lock);
+      load_sup_page(sp);
+      lock_acquire(&frame_lock);
+      frame_table_settle(sp);
+    }
+    frame_table_find_with_addr(sp->faddr)->pins++;
+  }
+  lock_release(&frame_lock);
+  return true;
+}
 
+// drops the pins pin_user_range() took on [uaddr, uaddr + len)
+void unpin_user_range(const void *uaddr, size_t len){
+  if(len == 0)
+    return;
+  void *last = pg_round_down(uaddr + len - 1);
+
+  lock_acquire(&frame_lock);
+  for(void *page = pg_round_down(uaddr); page <= last; page += PGSIZE){
+    struct sup_page *sp = sup_page_lookup(thread_current(), page);
+    struct frame *f = frame_table_find_with_addr(sp->faddr);
+    ASSERT(f->pins > 0);
+    f->pins--;
+  }
+  lock_release(&frame_lock);
+}
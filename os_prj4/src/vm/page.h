@@ -23,15 +23,33 @@ struct sup_page {
     int mid; // used if mmap was used to map this file to vm
 
     int swap_num;
-    struct lock page_lock;
+    bool swap_cached; // resident, and swap_num still holds the same data
     bool pinned;
     // page related to stack
 
     void *vaddr; // address of current page 
     void *faddr; // address of frame
+    bool zero_mapped; // shared zero page mapped read-only, no frame yet
+    uint32_t *pd; // page directory of the owning process
+    struct thread *owner; // the owning process
+    struct list_elem share_elem; // in the sharers of a shared text frame
     struct hash_elem elem;
 };
 
+// a range of pages backed by one file: an ELF segment or an mmap.
+// a page in it gets its sup_page only when first looked up
+struct vma {
+  void *start, *end; // page aligned
+  enum page_type type; // PG_FILE or PG_MMAP
+  struct file *file;
+  off_t ofs; // file offset of start
+  size_t read_bytes; // bytes from the file, the rest is zeroes
+  bool writable;
+  int mid;
+  int advice; // MADV_NORMAL, MADV_RANDOM or MADV_SEQUENTIAL
+  struct list_elem elem; // in thread's vma_list, sorted by start
+};
+
 // structure for mmap list. need len, file, and start_addr
 struct mmap_file {
   struct file *file;
@@ -42,14 +60,23 @@ struct mmap_file {
 };
 
 
-void load_sup_page(struct sup_page *sp);
+bool load_sup_page(struct sup_page *sp);
+void sup_page_populate(void *addr, off_t len);
+bool user_range_mapped(const void *uaddr, size_t len, bool writable);
+bool pin_user_range(const void *uaddr, size_t len, bool writable);
+void unpin_user_range(const void *uaddr, size_t len);
 void init_sup_page_table(struct thread *);
+void destroy_sup_page_table(struct thread *);
+void sup_page_table_remove_mmap(struct mmap_file *mf);
+void sup_page_table_sync_mmap(struct mmap_file *mf);
+bool sup_page_writeback(struct sup_page *sp);
 void sup_page_table_stack_growth(void *vaddr);
 struct sup_page *sup_page_find_with_vaddr(void *vaddr);
+bool sup_page_range_free(void *start, size_t size);
+void sup_page_madvise(void *addr, size_t len, int advice);
 void sup_page_table_insert_file(struct file *file, off_t ofs, uint8_t *upage,
-              uint32_t page_read_bytes, uint32_t page_zero_bytes, bool writable);
-void sup_page_table_insert_mmap(struct file *file, off_t ofs, uint8_t *upage,
-              uint32_t page_read_bytes, uint32_t page_zero_bytes, bool writable,
-              int mid);
+              uint32_t read_bytes, uint32_t zero_bytes, bool writable);
+void sup_page_table_insert_mmap(struct file *file, uint8_t *upage,
+              off_t len, bool writable, int mid);
 
 #endif
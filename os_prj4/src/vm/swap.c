@@ -1,18 +1,67 @@
 #include "vm/swap.h"
+#include "vm/zswap.h"
 #include "devices/block.h"
 #include "threads/vaddr.h"
 #include "threads/synch.h"
 #include "threads/thread.h"
+#include "threads/malloc.h"
+#include "threads/palloc.h"
+#include <string.h>
 #include <stdbool.h>
 #include <stdio.h>
 #include <bitmap.h>
 
+#define SECTORS_PER_PAGE (PGSIZE / BLOCK_SECTOR_SIZE)
+
+// number of slots handed out as one contiguous run, so pages
+// evicted one after another end up next to each other on disk
+#define SWAP_CLUSTER 16
+
 
 struct block *swap_block;
 int swap_size;
 struct bitmap *swap_used;
 struct lock swap_lock;
 
+// number of pages stored in each slot. more than one after fork()
+// shares a page that then gets evicted
+static uint8_t *slot_refs;
+
+// next-fit cursor: where the search for a new cluster starts
+static size_t swap_cursor;
+
+// slots left in the current cluster, and the next one to use
+static size_t cluster_next;
+static size_t cluster_left;
+
+// address space each slot was written for, NULL while the slot is
+// free, still being written, or only held by zswap
+static const void **slot_owner;
+
+// swap-in readahead: reading slot N from disk reads the run of
+// slots around it that were written for the same address space, up
+// to SWAP_RA_PAGES in all, into ra_buf with a single request. the
+// run reaches up to SWAP_RA_PAGES / 2 slots back, since pages
+// evicted in address order from a stack growing down, or faulted
+// back in backwards, sit below N, and takes the rest after N. a
+// later fault on one of them is a memcpy. there is a single window,
+// replaced by the next readahead. ra_lock keeps the window still
+// while it is read from or filled; ra_valid and ra_pending change
+// only under swap_lock, so freeing a slot can invalidate its copy
+#define SWAP_RA_PAGES 8
+
+static struct lock ra_lock;
+static uint8_t *ra_buf;
+static size_t ra_first; // slot in ra_buf[0]
+static size_t ra_cnt;
+static unsigned ra_valid; // bit i: ra_buf page i holds slot ra_first + i
+static unsigned ra_pending; // bit i: page i is being read
+
+static long long ra_reads, ra_hits, ra_wasted;
+
+static int alloc_slot(void);
+static void ra_drop(size_t slot);
+
 
 void swap_init(){
   swap_block = block_get_role(BLOCK_SWAP);
@@ -22,65 +71,205 @@ void swap_init(){
   swap_size = block_size(swap_block) * BLOCK_SECTOR_SIZE / PGSIZE;
   swap_used = bitmap_create(swap_size);
   bitmap_set_all(swap_used, false);
+  slot_refs = calloc(swap_size, sizeof *slot_refs);
+  slot_owner = calloc(swap_size, sizeof *slot_owner);
+  if(slot_refs == NULL || slot_owner == NULL)
+    PANIC("no memory for swap slot table");
+  ra_buf = palloc_get_multiple(PAL_ASSERT, SWAP_RA_PAGES);
 
   lock_init(&swap_lock);
+  lock_init(&ra_lock);
+  zswap_init(swap_size);
 }
 
-// saves page in addr to swap
-// returns swap number
-int swap_save_into_swap(void *addr){
-  int unused_swap = -1;
+// finds a free slot and marks it used. swap_lock must be held
+// returns -1 if swap is full
+static int alloc_slot(void){
+  size_t slot;
 
-  lock_acquire(&swap_lock);
-  // find unused swap space
-  for(int i=0; i<swap_size; i++){
-    if(bitmap_test(swap_used, i) == false){
-      unused_swap = i;
-      break;
-    }
+  // keep filling the current cluster while it lasts
+  while(cluster_left > 0){
+    slot = cluster_next++;
+    cluster_left--;
+    if(!bitmap_test(swap_used, slot))
+      goto found;
   }
 
-  // couldn't find unused swap
-  if (unused_swap == -1){
-    return -1;
+  // start a new cluster at the cursor, wrapping around once
+  slot = bitmap_scan(swap_used, swap_cursor, SWAP_CLUSTER, false);
+  if(slot == BITMAP_ERROR)
+    slot = bitmap_scan(swap_used, 0, SWAP_CLUSTER, false);
+  if(slot != BITMAP_ERROR){
+    cluster_next = slot + 1;
+    cluster_left = SWAP_CLUSTER - 1;
+    goto found;
   }
 
-  bitmap_set(swap_used, unused_swap, true);
+  // no free cluster left, settle for any single slot
+  slot = bitmap_scan(swap_used, swap_cursor, 1, false);
+  if(slot == BITMAP_ERROR)
+    slot = bitmap_scan(swap_used, 0, 1, false);
+  if(slot == BITMAP_ERROR)
+    return -1;
+
+found:
+  bitmap_mark(swap_used, slot);
+  slot_refs[slot] = 1;
+  swap_cursor = slot + 1 < (size_t) swap_size ? slot + 1 : 0;
+  return slot;
+}
 
-  // loops page and writes block sectors
-  int cur_sector = 0;
-  int swap_sec = unused_swap * (PGSIZE / BLOCK_SECTOR_SIZE);
-  for(int i=0; i<PGSIZE/BLOCK_SECTOR_SIZE; i++){
-    block_write(swap_block, swap_sec+cur_sector, addr);
+// saves page in addr, which belongs to address space owner, to swap
+// returns swap number, or -1 if swap is full
+int swap_save_into_swap(void *addr, const void *owner){
+  lock_acquire(&swap_lock);
+  int unused_swap = alloc_slot();
+  lock_release(&swap_lock);
 
-    addr += BLOCK_SECTOR_SIZE;
-    cur_sector++;
-  }
+  if(unused_swap == -1)
+    return -1;
+
+  // the slot is ours now, so the write can go without the lock.
+  // a page that fits in the compressed pool never reaches the disk,
+  // otherwise the whole page is a single multi-sector request
+  if(zswap_store(unused_swap, addr))
+    return unused_swap;
+  block_write_multiple(swap_block, unused_swap * SECTORS_PER_PAGE,
+                       SECTORS_PER_PAGE, addr);
 
+  // only now is the slot worth reading ahead
+  lock_acquire(&swap_lock);
+  slot_owner[unused_swap] = owner;
   lock_release(&swap_lock);
 
   return unused_swap;
 }
 
 
+// copies the readahead copy of slot to addr, if there is one
+static bool ra_load(size_t slot, void *addr){
+  bool hit = false;
+
+  lock_acquire(&ra_lock);
+  lock_acquire(&swap_lock);
+  if(slot >= ra_first && slot < ra_first + ra_cnt
+     && (ra_valid & (1u << (slot - ra_first)))){
+    ra_valid &= ~(1u << (slot - ra_first));
+    hit = true;
+  }
+  lock_release(&swap_lock);
+  if(hit){
+    memcpy(addr, ra_buf + (slot - ra_first) * PGSIZE, PGSIZE);
+    ra_hits++;
+  }
+  lock_release(&ra_lock);
+  return hit;
+}
+
+// reads the run of slots around slot that belong to the same
+// address space into the readahead window, replacing the old one,
+// and copies slot itself to addr. returns false, having read
+// nothing, if there is no neighbour worth reading
+static bool ra_fill(size_t slot, void *addr){
+  lock_acquire(&ra_lock);
+  lock_acquire(&swap_lock);
+  const void *owner = slot_owner[slot];
+  size_t first = slot, end = slot + 1;
+  if(owner != NULL){
+    while(first > 0 && slot - first < SWAP_RA_PAGES / 2
+          && slot_owner[first - 1] == owner)
+      first--;
+    while(end - first < SWAP_RA_PAGES && end < (size_t) swap_size
+          && slot_owner[end] == owner)
+      end++;
+  }
+  size_t cnt = end - first;
+  if(cnt == 1){
+    lock_release(&swap_lock);
+    lock_release(&ra_lock);
+    return false;
+  }
+  for(; ra_valid != 0; ra_valid &= ra_valid - 1)
+    ra_wasted++;
+  ra_first = first;
+  ra_cnt = cnt;
+  // slot itself goes to addr, not into the window
+  ra_pending = ((1u << cnt) - 1) & ~(1u << (slot - first));
+  lock_release(&swap_lock);
+
+  block_read_multiple(swap_block, first * SECTORS_PER_PAGE,
+                      cnt * SECTORS_PER_PAGE, ra_buf);
+  memcpy(addr, ra_buf + (slot - first) * PGSIZE, PGSIZE);
+  ra_reads += cnt - 1;
+
+  // slots freed during the read were dropped from ra_pending
+  lock_acquire(&swap_lock);
+  ra_valid = ra_pending;
+  ra_pending = 0;
+  lock_release(&swap_lock);
+  lock_release(&ra_lock);
+  return true;
+}
+
+// the contents of slot are going away: forget its readahead copy.
+// swap_lock must be held
+static void ra_drop(size_t slot){
+  if(slot < ra_first || slot >= ra_first + ra_cnt)
+    return;
+  unsigned bit = 1u << (slot - ra_first);
+  if(ra_valid & bit)
+    ra_wasted++;
+  ra_valid &= ~bit;
+  ra_pending &= ~bit;
+}
+
+// copies swap slot swap_number to addr. the slot stays allocated
+void swap_read_slot(int swap_number, void *addr){
+  ASSERT(bitmap_test(swap_used, swap_number));
+
+  if(!zswap_load(swap_number, addr) && !ra_load(swap_number, addr)
+     && !ra_fill(swap_number, addr))
+    block_read_multiple(swap_block, swap_number * SECTORS_PER_PAGE,
+                        SECTORS_PER_PAGE, addr);
+}
+
 // uses swap number
-// frees swap space, copies from swap to addr
+// copies from swap to addr, then drops our reference to the slot
 void swap_load_from_swap(int swap_number, void *addr){
   if(bitmap_test(swap_used, swap_number) == false)
     return;
 
-  lock_acquire(&swap_lock);
+  swap_read_slot(swap_number, addr);
 
-  bitmap_set(swap_used, swap_number, false);
-  int cur_sector = 0;
-  int swap_sec = swap_number * (PGSIZE / BLOCK_SECTOR_SIZE);
-  for(int i=0; i<PGSIZE/BLOCK_SECTOR_SIZE; i++){
-    block_read(swap_block, swap_sec+cur_sector, addr);
+  // free only after reading, or the slot could be reused and
+  // overwritten under us
+  swap_free_slot(swap_number);
+}
 
-    addr += BLOCK_SECTOR_SIZE;
-    cur_sector++;
+// drops one reference to the swap slot without reading it (owner
+// went away), freeing it with the last one
+void swap_free_slot(int swap_number){
+  lock_acquire(&swap_lock);
+  ASSERT(slot_refs[swap_number] > 0);
+  if(--slot_refs[swap_number] == 0){
+    bitmap_reset(swap_used, swap_number);
+    slot_owner[swap_number] = NULL;
+    ra_drop(swap_number);
+    zswap_invalidate(swap_number);
   }
+  lock_release(&swap_lock);
+}
 
+// adds a reference to a swap slot in use, for another page with the
+// same contents
+void swap_dup_slot(int swap_number){
+  lock_acquire(&swap_lock);
+  ASSERT(slot_refs[swap_number] > 0 && slot_refs[swap_number] < UINT8_MAX);
+  slot_refs[swap_number]++;
   lock_release(&swap_lock);
+}
 
+void swap_print_stats(void){
+  printf("Swap: %lld pages read ahead, %lld used, %lld wasted\n",
+         ra_reads, ra_hits, ra_wasted);
 }
@@ -3,7 +3,11 @@
 
 
 void swap_init(void);
-int swap_save_into_swap(void *addr);
+int swap_save_into_swap(void *addr, const void *owner);
 void swap_load_from_swap(int swap_number, void *addr);
+void swap_read_slot(int swap_number, void *addr);
+void swap_free_slot(int swap_number);
+void swap_dup_slot(int swap_number);
+void swap_print_stats(void);
 
 #endif
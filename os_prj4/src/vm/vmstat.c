@@ -0,0 +1,54 @@
+#include "vm/vmstat.h"
+#include <stdio.h>
+
+bool vmstat_enabled;
+struct vmstat vmstat_global;
+
+static uint64_t rdtsc(void){
+  uint32_t lo, hi;
+  asm volatile("rdtsc" : "=a" (lo), "=d" (hi));
+  return (uint64_t) hi << 32 | lo;
+}
+
+// timestamp for vmstat_fault_end()
+uint64_t vmstat_fault_begin(void){
+  return rdtsc();
+}
+
+// counts a fault of t that began at start
+void vmstat_fault_end(struct thread *t, bool major, uint64_t start){
+  uint64_t cycles = rdtsc() - start;
+  int bucket = 0;
+
+  cycles >>= VMSTAT_HIST_SHIFT;
+  while(cycles > 1 && bucket < VMSTAT_HIST_BUCKETS - 1){
+    cycles >>= 1;
+    bucket++;
+  }
+
+  if(major)
+    VMSTAT_INC(t, major_faults);
+  else
+    VMSTAT_INC(t, minor_faults);
+  VMSTAT_INC(t, fault_hist[bucket]);
+}
+
+void vmstat_print(const char *name, const struct vmstat *st){
+  printf("%s vmstat: %u minor faults, %u major, %u stack growths\n",
+         name, st->minor_faults, st->major_faults, st->stack_growths);
+  printf("%s vmstat: evicted %u file, %u mmap, %u stack pages\n",
+         name, st->evictions[VMSTAT_EVICT_FILE],
+         st->evictions[VMSTAT_EVICT_MMAP], st->evictions[VMSTAT_EVICT_STACK]);
+  printf("%s vmstat: %u swapped in, %u swapped out\n",
+         name, st->swap_ins, st->swap_outs);
+  printf("%s vmstat: fault cycles", name);
+  for(int i = 0; i < VMSTAT_HIST_BUCKETS; i++)
+    if(st->fault_hist[i] > 0)
+      printf(" 2^%d:%u", i + VMSTAT_HIST_SHIFT, st->fault_hist[i]);
+  printf("\n");
+}
+
+void vmstat_print_stats(void){
+  if(vmstat_enabled)
+    vmstat_print("system", &vmstat_global);
+}
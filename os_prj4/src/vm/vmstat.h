@@ -0,0 +1,22 @@
+#ifndef VM_VMSTAT_H
+#define VM_VMSTAT_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <vmstat.h>
+#include "threads/thread.h"
+
+// -vmstat: print each process's counters when it exits
+extern bool vmstat_enabled;
+extern struct vmstat vmstat_global;
+
+// counts one FIELD event for thread T and for the system
+#define VMSTAT_INC(T, FIELD) \
+  ((T)->vmstat.FIELD++, vmstat_global.FIELD++)
+
+uint64_t vmstat_fault_begin(void);
+void vmstat_fault_end(struct thread *, bool major, uint64_t start);
+void vmstat_print(const char *name, const struct vmstat *);
+void vmstat_print_stats(void);
+
+#endif
@@ -0,0 +1,225 @@
+#include "vm/zswap.h"
+#include "threads/vaddr.h"
+#include "threads/synch.h"
+#include "threads/malloc.h"
+#include <debug.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+// compressed swap cache: pages on their way to the swap disk are
+// compressed and kept in memory instead, as long as the pool has
+// room. the swap slot stays allocated and is the key, so swap.c
+// only has to ask here before touching the disk
+
+// default pool size, in pages of kernel memory
+#define ZSWAP_POOL_PAGES 64
+
+// pages that do not compress to half their size go to disk: they
+// would not save much, and malloc only packs blocks up to PGSIZE/2
+#define ZSWAP_MAX_LEN (PGSIZE / 2 - sizeof(struct zswap_entry))
+
+struct zswap_entry {
+  uint16_t len; // bytes of data
+  uint8_t data[];
+};
+
+size_t zswap_pool_pages = ZSWAP_POOL_PAGES;
+
+static struct zswap_entry **entries; // by swap slot, NULL if on disk
+static size_t entry_cnt;
+static size_t pool_bytes; // malloc'd for entries
+static struct lock zswap_lock;
+
+// compressor scratch, protected by zswap_lock
+#define HASH_BITS 12
+static uint16_t hash_table[1 << HASH_BITS];
+static uint8_t out_buf[PGSIZE];
+
+static long long stores, rejects, pool_full;
+static long long hits, misses;
+static long long bytes_in, bytes_out;
+
+static size_t lz_compress(const uint8_t *src, uint8_t *dst, size_t max);
+static void lz_decompress(const uint8_t *src, uint8_t *dst);
+
+
+void zswap_init(size_t slot_cnt){
+  lock_init(&zswap_lock);
+  if(zswap_pool_pages == 0)
+    return;
+  entries = calloc(slot_cnt, sizeof *entries);
+  if(entries == NULL)
+    PANIC("no memory for zswap");
+  entry_cnt = slot_cnt;
+}
+
+// keeps a compressed copy of page for swap slot. returns false if
+// the page has to be written to disk after all
+bool zswap_store(size_t slot, const void *page){
+  if(entries == NULL)
+    return false;
+  ASSERT(slot < entry_cnt && entries[slot] == NULL);
+
+  lock_acquire(&zswap_lock);
+  size_t len = lz_compress(page, out_buf, ZSWAP_MAX_LEN);
+  if(len == 0){
+    rejects++;
+    lock_release(&zswap_lock);
+    return false;
+  }
+  size_t size = sizeof(struct zswap_entry) + len;
+  struct zswap_entry *e = NULL;
+  if(pool_bytes + size <= zswap_pool_pages * PGSIZE)
+    e = malloc(size);
+  if(e == NULL){
+    pool_full++;
+    lock_release(&zswap_lock);
+    return false;
+  }
+  e->len = len;
+  memcpy(e->data, out_buf, len);
+  entries[slot] = e;
+  pool_bytes += size;
+  stores++;
+  bytes_in += PGSIZE;
+  bytes_out += len;
+  lock_release(&zswap_lock);
+  return true;
+}
+
+// fills page from the compressed copy for swap slot, if there is
+// one. the copy stays until the slot is freed
+bool zswap_load(size_t slot, void *page){
+  if(entries == NULL)
+    return false;
+
+  lock_acquire(&zswap_lock);
+  struct zswap_entry *e = entries[slot];
+  if(e != NULL){
+    lz_decompress(e->data, page);
+    hits++;
+  }
+  else
+    misses++;
+  lock_release(&zswap_lock);
+  return e != NULL;
+}
+
+// the swap slot was freed: drop its compressed copy
+void zswap_invalidate(size_t slot){
+  if(entries == NULL)
+    return;
+
+  lock_acquire(&zswap_lock);
+  struct zswap_entry *e = entries[slot];
+  if(e != NULL){
+    pool_bytes -= sizeof(struct zswap_entry) + e->len;
+    entries[slot] = NULL;
+    free(e);
+  }
+  lock_release(&zswap_lock);
+}
+
+void zswap_print_stats(void){
+  if(entries == NULL)
+    return;
+  printf("Zswap: %lld pages stored, %lld incompressible, %lld pool full\n",
+         stores, rejects, pool_full);
+  printf("Zswap: %lld loads from memory, %lld from disk\n", hits, misses);
+  printf("Zswap: compressed to %lld%% on average\n",
+         bytes_in > 0 ? bytes_out * 100 / bytes_in : 0);
+}
+
+// a small LZ77 in the style of LZRW1. the output is a sequence of
+// groups: a 16-bit control word, then 16 items. a clear bit is a
+// literal byte. a set bit is a match: 12 bits of offset back into
+// the output, 4 bits of length - 3, and an extra length byte if
+// those are all ones
+
+#define MIN_MATCH 3
+#define MAX_OFFSET 4095
+#define MAX_MATCH (MIN_MATCH + 15 + 255)
+
+static unsigned hash3(const uint8_t *p){
+  uint32_t v = p[0] | p[1] << 8 | p[2] << 16;
+  return (v * 2654435761u) >> (32 - HASH_BITS);
+}
+
+// compresses the page at src into dst. returns the compressed size,
+// or 0 if it would not fit in max bytes
+static size_t lz_compress(const uint8_t *src, uint8_t *dst, size_t max){
+  size_t ip = 0, op = 2, ctrl_pos = 0;
+  uint16_t ctrl = 0;
+  int bit = 0;
+
+  memset(hash_table, 0xff, sizeof hash_table);
+  while(ip < PGSIZE){
+    if(bit == 16){
+      dst[ctrl_pos] = ctrl;
+      dst[ctrl_pos + 1] = ctrl >> 8;
+      ctrl_pos = op;
+      op += 2;
+      ctrl = 0;
+      bit = 0;
+    }
+    // room for a control word and the longest item
+    if(op + 5 > max)
+      return 0;
+
+    size_t len = 0, off = 0;
+    if(ip + MIN_MATCH <= PGSIZE){
+      unsigned h = hash3(src + ip);
+      size_t cand = hash_table[h];
+      hash_table[h] = ip;
+      if(cand != 0xffff && ip - cand <= MAX_OFFSET
+         && !memcmp(src + cand, src + ip, MIN_MATCH)){
+        size_t limit = PGSIZE - ip < MAX_MATCH ? PGSIZE - ip : MAX_MATCH;
+        off = ip - cand;
+        len = MIN_MATCH;
+        while(len < limit && src[cand + len] == src[ip + len])
+          len++;
+      }
+    }
+
+    if(len >= MIN_MATCH){
+      size_t n = len - MIN_MATCH;
+      ctrl |= 1 << bit;
+      dst[op++] = off >> 4;
+      dst[op++] = (off & 0xf) << 4 | (n < 15 ? n : 15);
+      if(n >= 15)
+        dst[op++] = n - 15;
+      ip += len;
+    }
+    else
+      dst[op++] = src[ip++];
+    bit++;
+  }
+  dst[ctrl_pos] = ctrl;
+  dst[ctrl_pos + 1] = ctrl >> 8;
+  return op;
+}
+
+// expands what lz_compress produced back into a page at dst
+static void lz_decompress(const uint8_t *src, uint8_t *dst){
+  size_t ip = 0, op = 0;
+
+  while(op < PGSIZE){
+    uint16_t ctrl = src[ip] | src[ip + 1] << 8;
+    ip += 2;
+    for(int bit = 0; bit < 16 && op < PGSIZE; bit++){
+      if(ctrl & (1 << bit)){
+        size_t off = src[ip] << 4 | src[ip + 1] >> 4;
+        size_t len = (src[ip + 1] & 0xf) + MIN_MATCH;
+        ip += 2;
+        if(len == MIN_MATCH + 15)
+          len += src[ip++];
+        // byte by byte: the match may overlap what it produces
+        for(size_t i = 0; i < len; i++, op++)
+          dst[op] = dst[op - off];
+      }
+      else
+        dst[op++] = src[ip++];
+    }
+  }
+}